@@ -0,0 +1,126 @@
+/*  
+    Copyright (C) 2011 Butterfly authors,
+    
+    This file is part of Butterfly.
+    
+    Butterfly is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Butterfly is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdint.h"
+#include "stdlib.h"
+
+#include "arena.h"
+#include "mem.h"
+
+/* the first chunk, later ones double up to ARENA_MAX_CHUNK */
+#define ARENA_CHUNK 4096
+#define ARENA_MAX_CHUNK (1 << 22)
+
+struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;
+    /* keeps data aligned for any object */
+    union {
+        void *p;
+        double d;
+        uint64_t n;
+    } data[];
+};
+typedef struct arena_chunk arena_chunk;
+
+struct arena {
+    /* the chunk being allocated from is first */
+    arena_chunk *chunks;
+    char *pos;
+    char *end;
+    size_t next_size;
+};
+
+arena *arena_new() {
+    arena *a = mem_sys_alloc(sizeof(arena));
+    a->chunks = NULL;
+    a->pos = NULL;
+    a->end = NULL;
+    a->next_size = ARENA_CHUNK;
+    return a;
+}
+
+static void arena_grow(arena *a, size_t need) {
+    size_t size = a->next_size;
+    while (size < need) {
+        size *= 2;
+    }
+    if (a->next_size < ARENA_MAX_CHUNK) {
+        a->next_size *= 2;
+    }
+    arena_chunk *c = mem_sys_alloc(sizeof(arena_chunk) + size);
+    c->next = a->chunks;
+    c->size = size;
+    a->chunks = c;
+    a->pos = (char *) c->data;
+    a->end = a->pos + size;
+}
+
+/*
+ * each allocation is preceded by its size, so it can be copied when it's
+ * grown
+ */
+void *arena_alloc(arena *a, size_t n) {
+    size_t need = sizeof(size_t) + ((n + 7) & ~(size_t) 7);
+    if ((size_t) (a->end - a->pos) < need) {
+        arena_grow(a, need);
+    }
+    size_t *res = (size_t *) a->pos;
+    a->pos += need;
+    *res = n;
+    return res + 1;
+}
+
+bool arena_owns(arena *a, const void *p) {
+    const char *c = p;
+    arena_chunk *chunk;
+    for (chunk = a->chunks; chunk != NULL; chunk = chunk->next) {
+        const char *start = (const char *) chunk->data;
+        if (c >= start && c < start + chunk->size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t arena_size_of(const void *p) {
+    return ((const size_t *) p)[-1];
+}
+
+/* keeps the newest, largest chunk for the next document */
+void arena_reset(arena *a) {
+    if (a->chunks == NULL) {
+        return;
+    }
+    arena_chunk *c = a->chunks->next;
+    while (c != NULL) {
+        arena_chunk *next = c->next;
+        mem_sys_free(c);
+        c = next;
+    }
+    a->chunks->next = NULL;
+    a->pos = (char *) a->chunks->data;
+    a->end = a->pos + a->chunks->size;
+}
+
+void arena_free(arena *a) {
+    arena_reset(a);
+    mem_sys_free(a->chunks);
+    mem_sys_free(a);
+}
@@ -0,0 +1,40 @@
+/*  
+    Copyright (C) 2011 Butterfly authors,
+    
+    This file is part of Butterfly.
+    
+    Butterfly is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Butterfly is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "stddef.h"
+#include "stdbool.h"
+
+/*
+ * a bump pointer region. everything allocated from it is released at once by
+ * arena_reset or arena_free
+ */
+struct arena;
+typedef struct arena arena;
+
+arena *arena_new();
+void *arena_alloc(arena *, size_t);
+bool arena_owns(arena *, const void *);
+size_t arena_size_of(const void *);
+void arena_reset(arena *);
+void arena_free(arena *);
+
+#endif
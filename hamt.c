@@ -0,0 +1,307 @@
+/*  
+    Copyright (C) 2011 Butterfly authors,
+    
+    This file is part of Butterfly.
+    
+    Butterfly is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Butterfly is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "assert.h"
+#include "stdlib.h"
+#include "string.h"
+
+#include "hamt.h"
+#include "mem.h"
+
+#define HAMT_MASK ((1u << HAMT_BITS) - 1)
+
+static uint32_t popcount(uint32_t x) {
+    x = x - ((x >> 1) & 0x55555555);
+    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+    x = (x + (x >> 4)) & 0x0f0f0f0f;
+    return (x * 0x01010101) >> 24;
+}
+
+static uint32_t slot_bit(uint32_t hash, int shift) {
+    return 1u << ((hash >> shift) & HAMT_MASK);
+}
+
+static uint32_t slot_index(hamt_node *n, uint32_t bit) {
+    return popcount(n->bitmap & (bit - 1));
+}
+
+static hamt_node *node_alloc(uint32_t count) {
+    hamt_node *n = mem_alloc(sizeof(hamt_node) + sizeof(hamt_entry) * count);
+    n->ref = 1;
+    n->bitmap = 0;
+    n->count = count;
+    return n;
+}
+
+static void entry_copy(hamt_entry *dst, hamt_entry *src) {
+    if (src->key == NULL) {
+        dst->key = NULL;
+        dst->data.node = src->data.node;
+        dst->data.node->ref += 1;
+    } else {
+        dst->key = object_copy(src->key);
+        dst->data.val = object_copy(src->data.val);
+    }
+}
+
+static void entry_release(hamt_entry *e) {
+    if (e->key == NULL) {
+        hamt_release(e->data.node);
+    } else {
+        object_free(e->key);
+        object_free(e->data.val);
+    }
+}
+
+/* a node has to be owned before it's modified, which copies it if shared */
+static hamt_node *node_own(hamt_node *n) {
+    if (n->ref == 1) {
+        return n;
+    }
+    hamt_node *res = node_alloc(n->count);
+    res->bitmap = n->bitmap;
+    uint32_t i;
+    for (i = 0; i < n->count; ++i) {
+        entry_copy(&res->entries[i], &n->entries[i]);
+    }
+    n->ref -= 1;
+    return res;
+}
+
+static hamt_node *node_insert_at
+        (hamt_node *n, uint32_t i, object *key, object *val) {
+    n = mem_realloc(n, sizeof(hamt_node) + sizeof(hamt_entry) * (n->count + 1));
+    memmove(&n->entries[i + 1], &n->entries[i],
+            sizeof(hamt_entry) * (n->count - i));
+    n->entries[i].key = object_copy(key);
+    n->entries[i].data.val = object_copy(val);
+    n->count += 1;
+    return n;
+}
+
+static void node_remove_at(hamt_node *n, uint32_t i) {
+    memmove(&n->entries[i], &n->entries[i + 1],
+            sizeof(hamt_entry) * (n->count - i - 1));
+    n->count -= 1;
+}
+
+/* builds the smallest sub-trie holding two entries, taking their references */
+static hamt_node *node_pair
+        (hamt_entry *a, uint32_t a_hash, hamt_entry *b, uint32_t b_hash,
+         int shift) {
+    hamt_node *n;
+    if (shift >= 32) {
+        n = node_alloc(2);
+        n->entries[0] = *a;
+        n->entries[1] = *b;
+        return n;
+    }
+    uint32_t a_bit = slot_bit(a_hash, shift);
+    uint32_t b_bit = slot_bit(b_hash, shift);
+    if (a_bit == b_bit) {
+        n = node_alloc(1);
+        n->bitmap = a_bit;
+        n->entries[0].key = NULL;
+        n->entries[0].data.node =
+            node_pair(a, a_hash, b, b_hash, shift + HAMT_BITS);
+        return n;
+    }
+    n = node_alloc(2);
+    n->bitmap = a_bit | b_bit;
+    if (a_bit < b_bit) {
+        n->entries[0] = *a;
+        n->entries[1] = *b;
+    } else {
+        n->entries[0] = *b;
+        n->entries[1] = *a;
+    }
+    return n;
+}
+
+static hamt_entry *node_find(hamt_node *n, uint32_t hash, object *key) {
+    int shift = 0;
+    while (n != NULL) {
+        uint32_t i;
+        if (shift >= 32) {
+            for (i = 0; i < n->count; ++i) {
+                if (object_eq(n->entries[i].key, key)) {
+                    return &n->entries[i];
+                }
+            }
+            return NULL;
+        }
+        uint32_t bit = slot_bit(hash, shift);
+        if (!(n->bitmap & bit)) {
+            return NULL;
+        }
+        hamt_entry *e = &n->entries[slot_index(n, bit)];
+        if (e->key != NULL) {
+            return object_eq(e->key, key) ? e : NULL;
+        }
+        n = e->data.node;
+        shift += HAMT_BITS;
+    }
+    return NULL;
+}
+
+static hamt_node *node_set
+        (hamt_node *n, uint32_t hash, int shift, object *key, object *val,
+         bool *added) {
+    n = node_own(n);
+    uint32_t i;
+    if (shift >= 32) {
+        for (i = 0; i < n->count; ++i) {
+            hamt_entry *e = &n->entries[i];
+            if (object_eq(e->key, key)) {
+                object *old = e->data.val;
+                e->data.val = object_copy(val);
+                object_free(old);
+                return n;
+            }
+        }
+        *added = true;
+        return node_insert_at(n, n->count, key, val);
+    }
+    uint32_t bit = slot_bit(hash, shift);
+    i = slot_index(n, bit);
+    if (!(n->bitmap & bit)) {
+        *added = true;
+        n = node_insert_at(n, i, key, val);
+        n->bitmap |= bit;
+        return n;
+    }
+    hamt_entry *e = &n->entries[i];
+    if (e->key == NULL) {
+        e->data.node =
+            node_set(e->data.node, hash, shift + HAMT_BITS, key, val, added);
+    } else if (object_eq(e->key, key)) {
+        object *old = e->data.val;
+        e->data.val = object_copy(val);
+        object_free(old);
+    } else {
+        *added = true;
+        hamt_entry existing = *e;
+        hamt_entry fresh;
+        fresh.key = object_copy(key);
+        fresh.data.val = object_copy(val);
+        e->key = NULL;
+        e->data.node = node_pair(&existing, object_hash(existing.key),
+                                 &fresh, hash, shift + HAMT_BITS);
+    }
+    return n;
+}
+
+/* removes a key that's known to be in the trie */
+static hamt_node *node_rem
+        (hamt_node *n, uint32_t hash, int shift, object *key) {
+    n = node_own(n);
+    uint32_t i;
+    if (shift >= 32) {
+        for (i = 0; !object_eq(n->entries[i].key, key); ++i);
+    } else {
+        uint32_t bit = slot_bit(hash, shift);
+        i = slot_index(n, bit);
+        hamt_entry *e = &n->entries[i];
+        if (e->key == NULL) {
+            hamt_node *child =
+                node_rem(e->data.node, hash, shift + HAMT_BITS, key);
+            if (child->count == 1 && child->entries[0].key != NULL) {
+                /* a lone record moves up into its parent */
+                *e = child->entries[0];
+                mem_free(child);
+            } else {
+                e->data.node = child;
+            }
+            return n;
+        }
+        n->bitmap &= ~bit;
+    }
+    entry_release(&n->entries[i]);
+    node_remove_at(n, i);
+    return n;
+}
+
+hamt_node *hamt_set(hamt_node *root, object *key, object *val, bool *added) {
+    *added = false;
+    if (root == NULL) {
+        root = node_alloc(0);
+    }
+    return node_set(root, object_hash(key), 0, key, val, added);
+}
+
+object *hamt_get(hamt_node *root, object *key) {
+    hamt_entry *e = node_find(root, object_hash(key), key);
+    if (e == NULL) {
+        return NULL;
+    }
+    return e->data.val;
+}
+
+hamt_node *hamt_rem(hamt_node *root, object *key, bool *removed) {
+    uint32_t hash = object_hash(key);
+    *removed = node_find(root, hash, key) != NULL;
+    if (!*removed) {
+        return root;
+    }
+    root = node_rem(root, hash, 0, key);
+    if (root->count == 0) {
+        mem_free(root);
+        return NULL;
+    }
+    return root;
+}
+
+void hamt_release(hamt_node *n) {
+    if (n == NULL || --n->ref > 0) {
+        return;
+    }
+    uint32_t i;
+    for (i = 0; i < n->count; ++i) {
+        entry_release(&n->entries[i]);
+    }
+    mem_free(n);
+}
+
+void hamt_cursor_init(hamt_cursor *c, hamt_node *root) {
+    c->depth = root == NULL ? -1 : 0;
+    c->nodes[0] = root;
+    c->pos[0] = 0;
+}
+
+bool hamt_cursor_next(hamt_cursor *c, object **key, object **val) {
+    while (c->depth >= 0) {
+        hamt_node *n = c->nodes[c->depth];
+        if (c->pos[c->depth] == n->count) {
+            c->depth -= 1;
+            continue;
+        }
+        hamt_entry *e = &n->entries[c->pos[c->depth]++];
+        if (e->key == NULL) {
+            assert(c->depth + 1 < HAMT_DEPTH);
+            c->depth += 1;
+            c->nodes[c->depth] = e->data.node;
+            c->pos[c->depth] = 0;
+            continue;
+        }
+        *key = e->key;
+        *val = e->data.val;
+        return true;
+    }
+    return false;
+}
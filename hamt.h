@@ -0,0 +1,74 @@
+/*  
+    Copyright (C) 2011 Butterfly authors,
+    
+    This file is part of Butterfly.
+    
+    Butterfly is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Butterfly is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HAMT_H
+#define HAMT_H
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#include "object.h"
+
+/* each level of the trie consumes this many bits of the hash */
+#define HAMT_BITS 5
+/* the levels needed to consume a 32 bit hash, plus one for collisions */
+#define HAMT_DEPTH 8
+
+struct hamt_node;
+typedef struct hamt_node hamt_node;
+
+struct hamt_entry {
+    /* NULL if the entry holds a sub-trie */
+    object *key;
+    union {
+        object *val;
+        hamt_node *node;
+    } data;
+};
+typedef struct hamt_entry hamt_entry;
+
+/*
+ * a hash array mapped trie. nodes are reference counted and shared between
+ * copies, they're copied on write. below the last level, keys whose hashes
+ * collide completely are kept in a flat node that's searched linearly
+ */
+struct hamt_node {
+    unsigned int ref;
+    /* the slots in use, one bit per HAMT_BITS value */
+    uint32_t bitmap;
+    /* the number of entries */
+    uint32_t count;
+    hamt_entry entries[];
+};
+
+struct hamt_cursor {
+    int depth;
+    hamt_node *nodes[HAMT_DEPTH];
+    uint32_t pos[HAMT_DEPTH];
+};
+typedef struct hamt_cursor hamt_cursor;
+
+hamt_node *hamt_set(hamt_node *, object *, object *, bool *);
+object *hamt_get(hamt_node *, object *);
+hamt_node *hamt_rem(hamt_node *, object *, bool *);
+void hamt_release(hamt_node *);
+void hamt_cursor_init(hamt_cursor *, hamt_node *);
+bool hamt_cursor_next(hamt_cursor *, object **, object **);
+
+#endif
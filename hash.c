@@ -0,0 +1,217 @@
+/*  
+    Copyright (C) 2011 Butterfly authors,
+    
+    This file is part of Butterfly.
+    
+    Butterfly is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Butterfly is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdio.h"
+#include "string.h"
+#include "time.h"
+
+#include "hash.h"
+
+static uint64_t seed[2];
+static int seeded = 0;
+
+#ifndef BUTTERFLY_HASH_SIPHASH
+/* the state wyhash starts from, worked out once from the seed */
+static uint64_t seed_state;
+static uint64_t mix(uint64_t, uint64_t);
+static const uint64_t secret[4];
+#endif
+
+/* /dev/urandom where there is one, otherwise the clock and the stack address */
+#ifdef __GNUC__
+__attribute__((constructor))
+#endif
+static void hash_seed() {
+    FILE *f;
+    if (seeded) {
+        return;
+    }
+    f = fopen("/dev/urandom", "rb");
+    if (f == NULL || fread(seed, sizeof(seed), 1, f) != 1) {
+        seed[0] = (uint64_t) time(NULL) * 0x9e3779b97f4a7c15ull;
+        seed[1] = (uint64_t) (uintptr_t) &f ^ (seed[0] >> 17);
+    }
+    if (f != NULL) {
+        fclose(f);
+    }
+#ifndef BUTTERFLY_HASH_SIPHASH
+    seed_state = seed[0] ^ mix(seed[0] ^ secret[0], secret[1]);
+#endif
+    seeded = 1;
+}
+
+/*
+ * hashes only live for the life of the process, so words are read in
+ * native byte order
+ */
+static uint64_t load_u64(const uint8_t *p) {
+    uint64_t res;
+    memcpy(&res, p, sizeof(res));
+    return res;
+}
+
+#ifdef BUTTERFLY_HASH_SIPHASH
+
+#define ROTL(x, b) (((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND \
+    do { \
+        v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32); \
+        v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2; \
+        v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0; \
+        v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32); \
+    } while (0)
+
+/* SipHash-1-3: one compression round per word and three to finish */
+uint64_t hash_bytes(const void *data, size_t len) {
+    const uint8_t *p = data;
+    const uint8_t *end = p + (len & ~(size_t) 7);
+    uint64_t v0, v1, v2, v3, m;
+    uint64_t last = (uint64_t) len << 56;
+    
+    hash_seed();
+    v0 = seed[0] ^ 0x736f6d6570736575ull;
+    v1 = seed[1] ^ 0x646f72616e646f6dull;
+    v2 = seed[0] ^ 0x6c7967656e657261ull;
+    v3 = seed[1] ^ 0x7465646279746573ull;
+    
+    for (; p != end; p += 8) {
+        m = load_u64(p);
+        v3 ^= m;
+        SIPROUND;
+        v0 ^= m;
+    }
+    switch (len & 7) {
+        case 7: last |= (uint64_t) p[6] << 48; /* fall through */
+        case 6: last |= (uint64_t) p[5] << 40; /* fall through */
+        case 5: last |= (uint64_t) p[4] << 32; /* fall through */
+        case 4: last |= (uint64_t) p[3] << 24; /* fall through */
+        case 3: last |= (uint64_t) p[2] << 16; /* fall through */
+        case 2: last |= (uint64_t) p[1] << 8; /* fall through */
+        case 1: last |= (uint64_t) p[0];
+    }
+    v3 ^= last;
+    SIPROUND;
+    v0 ^= last;
+    
+    v2 ^= 0xff;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+#else
+
+static uint64_t load_u32(const uint8_t *p) {
+    uint32_t res;
+    memcpy(&res, p, sizeof(res));
+    return res;
+}
+
+static const uint64_t secret[4] = {
+    0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+    0x8ebc6af09c88c6dbull, 0x589965cc75374cc3ull
+};
+
+/*
+ * the 128 bit product of a and b, low half xored into a and high half into b.
+ * keeping the operands means a zero operand, which input can be picked to
+ * make, doesn't wipe out the seeded state
+ */
+static void mum(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t) *a * *b;
+    *a ^= (uint64_t) r;
+    *b ^= (uint64_t) (r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32;
+    uint64_t la = (uint32_t) *a, lb = (uint32_t) *b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a ^= lo;
+    *b ^= rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static uint64_t mix(uint64_t a, uint64_t b) {
+    mum(&a, &b);
+    return a ^ b;
+}
+
+/*
+ * wyhash: 16 bytes per multiply, 48 per round of three independent lanes on
+ * long input, and short input read in at most four loads. the seeded state
+ * goes into both operands of every multiply
+ */
+uint64_t hash_bytes(const void *data, size_t len) {
+    const uint8_t *p = data;
+    uint64_t a, b, s;
+    
+    hash_seed();
+    s = seed_state;
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (load_u32(p) << 32) | load_u32(p + ((len >> 3) << 2));
+            b = (load_u32(p + len - 4) << 32) |
+                load_u32(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8) |
+                p[len - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i > 48) {
+            uint64_t s1 = s, s2 = s;
+            do {
+                s = mix(load_u64(p) ^ secret[1] ^ s, load_u64(p + 8) ^ s);
+                s1 = mix(load_u64(p + 16) ^ secret[2] ^ s1,
+                        load_u64(p + 24) ^ s1);
+                s2 = mix(load_u64(p + 32) ^ secret[3] ^ s2,
+                        load_u64(p + 40) ^ s2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            s ^= s1 ^ s2;
+        }
+        while (i > 16) {
+            s = mix(load_u64(p) ^ secret[1] ^ s, load_u64(p + 8) ^ s);
+            p += 16;
+            i -= 16;
+        }
+        a = load_u64(p + i - 16);
+        b = load_u64(p + i - 8);
+    }
+    a ^= secret[1] ^ s;
+    b ^= s;
+    mum(&a, &b);
+    return mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+#endif
+
+uint64_t hash_u64(uint64_t n) {
+    return hash_bytes(&n, sizeof(n));
+}
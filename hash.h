@@ -0,0 +1,34 @@
+/*  
+    Copyright (C) 2011 Butterfly authors,
+    
+    This file is part of Butterfly.
+    
+    Butterfly is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Butterfly is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HASH_H
+#define HASH_H
+
+#include "stddef.h"
+#include "stdint.h"
+
+/*
+ * keyed hashing with a seed picked once per process, so the hashes of keys
+ * that come from untrusted input can't be predicted to collide. wyhash is
+ * used unless BUTTERFLY_HASH_SIPHASH selects SipHash-1-3
+ */
+uint64_t hash_bytes(const void *, size_t);
+uint64_t hash_u64(uint64_t);
+
+#endif
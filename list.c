@@ -18,189 +18,727 @@
 */
 
 #include "assert.h"
+#include "stddef.h"
 #include "stdlib.h"
+#include "string.h"
 
 #include "list.h"
+#include "mem.h"
 
-static list *create_leaf(object *obj) {
-    list *result = malloc(sizeof(list));
+#define BRANCH_SIZE (offsetof(list, data) + sizeof(finger_branch))
+#define LEAF_SIZE (offsetof(list, data) + sizeof(list_chunk))
+
+static list *alloc_leaf() {
+    list *result = mem_slab_alloc(LEAF_SIZE);
     result->type = LEAF;
-    result->data.leaf = object_copy(obj);
+    result->ref = 1;
     return result;
 }
 
-static list *free_leaf(list *leaf) {
-    assert(leaf->type == LEAF);
-    object_free(leaf->data.leaf);
-    free(leaf);
-    return NULL;
+static void node_free(list *l) {
+    mem_slab_free(l, l->type == LEAF ? LEAF_SIZE : BRANCH_SIZE);
+}
+
+static list *create_leaf(object *obj) {
+    list *result = alloc_leaf();
+    result->data.leaf.count = 1;
+    result->data.leaf.items[0] = object_copy(obj);
+    return result;
 }
 
 static int32_t node_length(list *l) {
+    if (l == NULL) {
+        return 0;
+    }
     if (l->type == LEAF) {
-        return 1;
+        return l->data.leaf.count;
     }
     return l->data.branch.nodes;
 }
 
-int32_t list_length(finger_branch *branch) {
-    return branch->nodes;
+static int32_t node_height(list *l) {
+    if (l == NULL) {
+        return 0;
+    }
+    if (l->type == LEAF) {
+        return 1;
+    }
+    return l->data.branch.height;
+}
+
+static void node_update(list *l) {
+    finger_branch *branch = &l->data.branch;
+    int32_t left_height = node_height(branch->left);
+    int32_t right_height = node_height(branch->right);
+    branch->nodes = node_length(branch->left) + node_length(branch->right);
+    branch->height = 1 + (left_height > right_height ? left_height : right_height);
 }
 
-static void list_ptr_set(list **child, int32_t i, object *obj) {
-    if ((*child)->type == LEAF) {
-        assert(i < 2 && i >= 0);
-        if (i == 0) {
-            object_free((*child)->data.leaf);
-            (*child)->data.leaf = object_copy(obj);
-        } else {
-            list *branch = malloc(sizeof(list));
-            branch->type = BRANCH;
-            branch->data.branch.left = *child;
-            branch->data.branch.right = create_leaf(obj);
-            branch->data.branch.nodes = 2;
-            *child = branch;
+static list *create_branch(list *left, list *right) {
+    list *result = mem_slab_alloc(BRANCH_SIZE);
+    result->type = BRANCH;
+    result->ref = 1;
+    result->data.branch.left = left;
+    result->data.branch.right = right;
+    node_update(result);
+    return result;
+}
+
+/*
+ * frees the nodes whose last reference is dropped in a single pass, without
+ * recursion. dead branches whose right subtree is still to be released are
+ * chained through their left pointer
+ */
+static void node_release(list *l) {
+    list *pending = NULL;
+    while (1) {
+        if (l != NULL && --l->ref == 0) {
+            if (l->type == BRANCH) {
+                list *left = l->data.branch.left;
+                l->data.branch.left = pending;
+                pending = l;
+                l = left;
+                continue;
+            }
+            int32_t i;
+            for (i = 0; i < l->data.leaf.count; ++i) {
+                object_free(l->data.leaf.items[i]);
+            }
+            node_free(l);
         }
-    } else {
-        list_set(&(*child)->data.branch, i, obj);
+        if (pending == NULL) {
+            return;
+        }
+        l = pending->data.branch.right;
+        list *next = pending->data.branch.left;
+        node_free(pending);
+        pending = next;
     }
 }
 
-void list_set(finger_branch *branch, int32_t i, object *obj) {
-    assert(i <= branch->nodes && i >= 0);
-    if (branch->nodes == 0) {
-        branch->left = create_leaf(obj);
+/*
+ * nodes may be shared between several lists, a node has to be owned before
+ * it's modified, which copies it if anybody else can see it
+ */
+static list *node_own(list *l) {
+    if (l->ref == 1) {
+        return l;
+    }
+    list *res;
+    if (l->type == BRANCH) {
+        res = create_branch(l->data.branch.left, l->data.branch.right);
+        res->data.branch.left->ref += 1;
+        res->data.branch.right->ref += 1;
     } else {
-        int32_t left_len = node_length(branch->left);
-        if (i >= left_len) {
-            if (branch->right != NULL) {
-                list_ptr_set(&branch->right, i - left_len, obj);
-            } else {
-                branch->right = create_leaf(obj);
-            }
-        } else {
-            list_ptr_set(&branch->left, i, obj);
+        res = alloc_leaf();
+        res->data.leaf.count = l->data.leaf.count;
+        int32_t i;
+        for (i = 0; i < l->data.leaf.count; ++i) {
+            res->data.leaf.items[i] = object_copy(l->data.leaf.items[i]);
         }
     }
-    if (i == branch->nodes) {
-        branch->nodes += 1;
+    l->ref -= 1;
+    return res;
+}
+
+static list *rotate_left(list *l) {
+    list *r = node_own(l->data.branch.right);
+    assert(r->type == BRANCH);
+    l->data.branch.right = r->data.branch.left;
+    node_update(l);
+    r->data.branch.left = l;
+    node_update(r);
+    return r;
+}
+
+static list *rotate_right(list *l) {
+    list *r = node_own(l->data.branch.left);
+    assert(r->type == BRANCH);
+    l->data.branch.left = r->data.branch.right;
+    node_update(l);
+    r->data.branch.right = l;
+    node_update(r);
+    return r;
+}
+
+static int32_t node_balance(list *l) {
+    return node_height(l->data.branch.left) - node_height(l->data.branch.right);
+}
+
+/* restores the AVL invariant of a branch whose children are balanced */
+static list *rebalance(list *l) {
+    finger_branch *branch = &l->data.branch;
+    int32_t balance = node_balance(l);
+    if (balance > 1) {
+        if (node_balance(branch->left) < 0) {
+            branch->left = rotate_left(node_own(branch->left));
+        }
+        return rotate_right(l);
+    }
+    if (balance < -1) {
+        if (node_balance(branch->right) > 0) {
+            branch->right = rotate_right(node_own(branch->right));
+        }
+        return rotate_left(l);
     }
+    node_update(l);
+    return l;
 }
 
-static object *list_ptr_get(list *child, int32_t i) {
-    if (child->type == LEAF) {
-        return object_copy(child->data.leaf);
+static void chunk_insert(list_chunk *chunk, int32_t i, object *obj) {
+    assert(chunk->count < LIST_CHUNK);
+    memmove(&chunk->items[i + 1], &chunk->items[i],
+            sizeof(object *) * (chunk->count - i));
+    chunk->items[i] = object_copy(obj);
+    chunk->count += 1;
+}
+
+/*
+ * a full leaf is split in half, except when inserting at either end, where
+ * the full leaf is kept so that lists built by appending stay densely packed
+ */
+static list *leaf_insert(list *l, int32_t i, object *obj) {
+    list_chunk *chunk = &l->data.leaf;
+    if (chunk->count < LIST_CHUNK) {
+        chunk_insert(chunk, i, obj);
+        return l;
+    }
+    if (i == 0) {
+        return create_branch(create_leaf(obj), l);
+    }
+    if (i == LIST_CHUNK) {
+        return create_branch(l, create_leaf(obj));
+    }
+    int32_t half = LIST_CHUNK / 2;
+    list *right = alloc_leaf();
+    right->data.leaf.count = LIST_CHUNK - half;
+    memcpy(right->data.leaf.items, &chunk->items[half],
+           sizeof(object *) * (LIST_CHUNK - half));
+    chunk->count = half;
+    if (i <= half) {
+        chunk_insert(chunk, i, obj);
     } else {
-        return list_get(&child->data.branch, i);
+        chunk_insert(&right->data.leaf, i - half, obj);
     }
+    return create_branch(l, right);
 }
 
-object *list_get(finger_branch *branch, int32_t i) {
-    if (i < 0 || i >= branch->nodes) {
-        return NULL;
+static list *node_insert(list *l, int32_t i, object *obj) {
+    if (l == NULL) {
+        return create_leaf(obj);
     }
+    l = node_own(l);
+    if (l->type == LEAF) {
+        return leaf_insert(l, i, obj);
+    }
+    finger_branch *branch = &l->data.branch;
     int32_t left_len = node_length(branch->left);
-    if (i >= left_len) {
-        i -= left_len;
-        return list_ptr_get(branch->right, i);
+    if (i < left_len) {
+        branch->left = node_insert(branch->left, i, obj);
     } else {
-        return list_ptr_get(branch->left, i);
+        branch->right = node_insert(branch->right, i - left_len, obj);
+    }
+    return rebalance(l);
+}
+
+/* joins two neighbouring leaves, taking over the references to both */
+static list *merge_leaves(list *left, list *right) {
+    left = node_own(left);
+    list_chunk *chunk = &left->data.leaf;
+    int32_t i;
+    for (i = 0; i < right->data.leaf.count; ++i) {
+        chunk->items[chunk->count++] = object_copy(right->data.leaf.items[i]);
     }
+    node_release(right);
+    return left;
 }
 
-static void list_ptr_insert_at(list **l, int32_t i, object *obj) {
-    if (*l == NULL) {
-        *l = create_leaf(obj);
+static list *node_remove(list *l, int32_t i) {
+    l = node_own(l);
+    if (l->type == LEAF) {
+        list_chunk *chunk = &l->data.leaf;
+        object_free(chunk->items[i]);
+        chunk->count -= 1;
+        if (chunk->count == 0) {
+            node_free(l);
+            return NULL;
+        }
+        memmove(&chunk->items[i], &chunk->items[i + 1],
+                sizeof(object *) * (chunk->count - i));
+        return l;
+    }
+    finger_branch *branch = &l->data.branch;
+    int32_t left_len = node_length(branch->left);
+    if (i < left_len) {
+        branch->left = node_remove(branch->left, i);
     } else {
-        if ((*l)->type == BRANCH) {
-            list_insert_at(&(*l)->data.branch, i, obj);
+        branch->right = node_remove(branch->right, i - left_len);
+    }
+    if (branch->left == NULL || branch->right == NULL) {
+        list *ret = branch->left != NULL ? branch->left : branch->right;
+        node_free(l);
+        return ret;
+    }
+    if (branch->left->type == LEAF && branch->right->type == LEAF &&
+            node_length(l) <= LIST_CHUNK / 2) {
+        list *ret = merge_leaves(branch->left, branch->right);
+        node_free(l);
+        return ret;
+    }
+    return rebalance(l);
+}
+
+/* returns the slot holding element i, the path to it must be owned to write */
+static object **node_find(list *l, int32_t i) {
+    while (l->type == BRANCH) {
+        int32_t left_len = node_length(l->data.branch.left);
+        if (i < left_len) {
+            l = l->data.branch.left;
         } else {
-            list *leaf = *l;
-            *l = malloc(sizeof(list));
-            (*l)->type = BRANCH;
-            (*l)->data.branch.nodes = 2;
-            (*l)->data.branch.left = create_leaf(obj);
-            (*l)->data.branch.right = leaf;
+            i -= left_len;
+            l = l->data.branch.right;
         }
     }
+    return &l->data.leaf.items[i];
+}
+
+/* copies elements [start, end) of a leaf into a new leaf */
+static list *leaf_slice(list *l, int32_t start, int32_t end) {
+    list *res = alloc_leaf();
+    res->data.leaf.count = end - start;
+    int32_t i;
+    for (i = start; i < end; ++i) {
+        res->data.leaf.items[i - start] = object_copy(l->data.leaf.items[i]);
+    }
+    return res;
+}
+
+/*
+ * joins two balanced trees by descending the spine of the taller one until
+ * the heights match, the join and split functions take over the references
+ * they're passed and return new ones
+ */
+static list *node_join(list *l, list *r) {
+    if (l == NULL) {
+        return r;
+    }
+    if (r == NULL) {
+        return l;
+    }
+    int32_t l_height = node_height(l);
+    int32_t r_height = node_height(r);
+    if (l_height > r_height + 1) {
+        l = node_own(l);
+        l->data.branch.right = node_join(l->data.branch.right, r);
+        return rebalance(l);
+    }
+    if (r_height > l_height + 1) {
+        r = node_own(r);
+        r->data.branch.left = node_join(l, r->data.branch.left);
+        return rebalance(r);
+    }
+    if (l->type == LEAF && r->type == LEAF &&
+            l->data.leaf.count + r->data.leaf.count <= LIST_CHUNK) {
+        return merge_leaves(l, r);
+    }
+    return create_branch(l, r);
 }
 
-void list_insert_at(finger_branch *branch, int32_t i, object *obj) {
-    assert (i >= 0 && i <= branch->nodes);
-    if (branch->nodes == 0) {
-        branch->left = create_leaf(obj);
+/* splits into the first i elements and the rest */
+static void node_split(list *l, int32_t i, list **left, list **right) {
+    if (i == 0) {
+        *left = NULL;
+        *right = l;
+        return;
+    }
+    if (i == node_length(l)) {
+        *left = l;
+        *right = NULL;
+        return;
+    }
+    if (l->type == LEAF) {
+        *left = leaf_slice(l, 0, i);
+        *right = leaf_slice(l, i, l->data.leaf.count);
+        node_release(l);
+        return;
+    }
+    list *l_child = l->data.branch.left;
+    list *r_child = l->data.branch.right;
+    l_child->ref += 1;
+    r_child->ref += 1;
+    node_release(l);
+    int32_t left_len = node_length(l_child);
+    if (i < left_len) {
+        node_split(l_child, i, left, right);
+        *right = node_join(*right, r_child);
     } else {
-        if (i == 0) {
-            list_ptr_insert_at(&branch->left, i, obj);
+        node_split(r_child, i - left_len, left, right);
+        *left = node_join(l_child, *left);
+    }
+}
+
+/* builds a balanced tree over consecutive leaves */
+static list *build_tree(list **leaves, int32_t count) {
+    if (count == 1) {
+        return leaves[0];
+    }
+    int32_t mid = count / 2;
+    return create_branch(build_tree(leaves, mid),
+                         build_tree(leaves + mid, count - mid));
+}
+
+/* moves the elements of a dense list into a tree, taking their references */
+static void list_promote(list_head *head) {
+    assert(head->root == NULL && head->len > 0);
+    int32_t count = (head->len + LIST_CHUNK - 1) / LIST_CHUNK;
+    list **leaves = mem_alloc(sizeof(list *) * count);
+    int32_t i;
+    for (i = 0; i < count; ++i) {
+        int32_t start = i * LIST_CHUNK;
+        int32_t n = head->len - start;
+        if (n > LIST_CHUNK) {
+            n = LIST_CHUNK;
+        }
+        leaves[i] = alloc_leaf();
+        leaves[i]->data.leaf.count = n;
+        memcpy(leaves[i]->data.leaf.items, &head->vec[start],
+               sizeof(object *) * n);
+    }
+    head->root = build_tree(leaves, count);
+    mem_free(leaves);
+    mem_free(head->vec);
+    head->vec = NULL;
+    head->len = 0;
+    head->cap = 0;
+}
+
+static void vec_reserve(list_head *head, int32_t len) {
+    if (len <= head->cap) {
+        return;
+    }
+    if (head->cap == 0) {
+        head->cap = 8;
+    }
+    while (head->cap < len) {
+        head->cap *= 2;
+    }
+    head->vec = mem_realloc(head->vec, sizeof(object *) * head->cap);
+}
+
+static void vec_push(list_head *head, object *obj) {
+    vec_reserve(head, head->len + 1);
+    head->vec[head->len++] = object_copy(obj);
+}
+
+void list_init(list_head *head) {
+    head->vec = NULL;
+    head->len = 0;
+    head->cap = 0;
+    head->root = NULL;
+}
+
+int32_t list_length(list_head *head) {
+    if (head->root == NULL) {
+        return head->len;
+    }
+    return node_length(head->root);
+}
+
+static object **list_slot(list_head *head, int32_t i) {
+    if (head->root == NULL) {
+        return &head->vec[i];
+    }
+    return node_find(head->root, i);
+}
+
+/* owns every node on the path to element i */
+static void list_own_path(list_head *head, int32_t i) {
+    list **l = &head->root;
+    while (1) {
+        *l = node_own(*l);
+        if ((*l)->type == LEAF) {
+            return;
+        }
+        int32_t left_len = node_length((*l)->data.branch.left);
+        if (i < left_len) {
+            l = &(*l)->data.branch.left;
         } else {
-            int32_t left_len = node_length(branch->left);
-            if (i >= left_len) {
-                list_ptr_insert_at(&branch->right, i-left_len, obj);
-            } else {
-                list_ptr_insert_at(&branch->left, i, obj);
-            }
+            i -= left_len;
+            l = &(*l)->data.branch.right;
         }
     }
-    branch->nodes += 1;
 }
 
-static list *list_ptr_remove(list *l, int32_t i) {
-    if (l->type == LEAF) {
-        free_leaf(l);
+void list_set(list_head *head, int32_t i, object *obj) {
+    assert(i <= list_length(head) && i >= 0);
+    if (i == list_length(head)) {
+        list_insert_at(head, i, obj);
+    } else {
+        if (head->root != NULL) {
+            list_own_path(head, i);
+        }
+        object **slot = list_slot(head, i);
+        object *old = *slot;
+        *slot = object_copy(obj);
+        object_free(old);
+    }
+}
+
+object *list_get(list_head *head, int32_t i) {
+    if (i < 0 || i >= list_length(head)) {
         return NULL;
+    }
+    return object_copy(*list_slot(head, i));
+}
+
+void list_insert_at(list_head *head, int32_t i, object *obj) {
+    assert (i >= 0 && i <= list_length(head));
+    if (head->root == NULL) {
+        if (i == head->len) {
+            vec_push(head, obj);
+            return;
+        }
+        list_promote(head);
+    }
+    head->root = node_insert(head->root, i, obj);
+}
+
+void list_remove(list_head *head, int32_t i) {
+    assert(i >= 0 && i < list_length(head));
+    if (head->root == NULL) {
+        if (i == head->len - 1) {
+            head->len -= 1;
+            object_free(head->vec[i]);
+            if (head->len == 0) {
+                mem_free(head->vec);
+                list_init(head);
+            }
+            return;
+        }
+        list_promote(head);
+    }
+    head->root = node_remove(head->root, i);
+    if (head->root == NULL) {
+        list_init(head);
+    }
+}
+
+/* appends obj, taking over the caller's reference to it */
+void list_push(list_head *head, object *obj) {
+    if (head->root == NULL) {
+        vec_reserve(head, head->len + 1);
+        head->vec[head->len++] = obj;
+    } else {
+        head->root = node_insert(head->root, list_length(head), obj);
+        object_free(obj);
+    }
+}
+
+/* appends n elements, taking over the caller's references to them */
+void list_push_array(list_head *head, object **objs, int32_t n) {
+    if (n == 0) {
+        return;
+    }
+    if (head->root == NULL) {
+        vec_reserve(head, head->len + n);
+        memcpy(&head->vec[head->len], objs, sizeof(object *) * n);
+        head->len += n;
+    } else {
+        int32_t i;
+        for (i = 0; i < n; ++i) {
+            list_push(head, objs[i]);
+        }
+    }
+}
+
+void list_clear(list_head *head) {
+    if (head->root != NULL) {
+        node_release(head->root);
     } else {
+        int32_t i;
+        for (i = 0; i < head->len; ++i) {
+            object_free(head->vec[i]);
+        }
+        mem_free(head->vec);
+    }
+    list_init(head);
+}
+
+/*
+ * returns a new reference to the tree of a list, copies share the tree so a
+ * dense list is moved into one first
+ */
+static list *list_share(list_head *head) {
+    if (head->root == NULL && head->len > 0) {
+        list_promote(head);
+    }
+    if (head->root != NULL) {
+        head->root->ref += 1;
+    }
+    return head->root;
+}
+
+void list_copy(list_head *src, list_head *dst) {
+    list_init(dst);
+    dst->root = list_share(src);
+}
+
+void list_concat(list_head *a, list_head *b, list_head *dst) {
+    list *l = list_share(a);
+    list *r = list_share(b);
+    list_init(dst);
+    dst->root = node_join(l, r);
+}
+
+void list_split(list_head *src, int32_t i, list_head *left, list_head *right) {
+    assert(i >= 0 && i <= list_length(src));
+    list *root = list_share(src);
+    list_init(left);
+    list_init(right);
+    if (root != NULL) {
+        node_split(root, i, &left->root, &right->root);
+    }
+}
+
+/* copies elements [start, end) */
+void list_slice(list_head *src, int32_t start, int32_t end, list_head *dst) {
+    assert(start >= 0 && start <= end && end <= list_length(src));
+    list *root = list_share(src);
+    list *head, *tail;
+    list_init(dst);
+    if (root == NULL) {
+        return;
+    }
+    node_split(root, end, &head, &tail);
+    node_release(tail);
+    node_split(head, start, &tail, &dst->root);
+    node_release(tail);
+}
+
+/* descends from l to the element at i, pushing the branches passed */
+static void cursor_descend(list_cursor *c, list *l, int32_t i) {
+    while (l->type == BRANCH) {
+        assert(c->depth < LIST_DEPTH);
         int32_t left_len = node_length(l->data.branch.left);
-        if (i >= left_len) {
+        list_step *step = &c->path[c->depth++];
+        step->branch = l;
+        step->right = i >= left_len;
+        if (step->right) {
             i -= left_len;
-            l->data.branch.right = list_ptr_remove(l->data.branch.right, i);
-            if (l->data.branch.right == NULL) {
-                list *ret = l->data.branch.left;
-                free(l);
-                return ret;
-            }
+            l = l->data.branch.right;
         } else {
-            l->data.branch.left = list_ptr_remove(l->data.branch.left, i);
-            if (l->data.branch.left == NULL) {
-                list *ret = l->data.branch.right;
-                free(l);
-                return ret;
-            }
+            l = l->data.branch.left;
         }
-        l->data.branch.nodes -= 1;
     }
-    return NULL;
+    c->leaf = l;
+    c->pos = i;
 }
 
-void list_remove(finger_branch *branch, int32_t i) {
-    assert(i >= 0 && i < branch->nodes);
-    if (branch->nodes == 0) {
-        return;
+/*
+ * starts at element i, which is the first element returned. i may be one
+ * past the end going forward and one before the start going backward
+ */
+void list_cursor_init(list_cursor *c, list_head *head, int32_t i, bool reverse) {
+    int32_t len = list_length(head);
+    assert(reverse ? (i >= -1 && i < len) : (i >= 0 && i <= len));
+    c->head = head;
+    c->reverse = reverse;
+    c->remaining = reverse ? i + 1 : len - i;
+    c->leaf = NULL;
+    c->pos = i;
+    c->depth = 0;
+    if (head->root != NULL && c->remaining > 0) {
+        cursor_descend(c, head->root, i);
     }
-    int32_t left_len = node_length(branch->left);
-    if (i >= left_len) {
-        branch->right = list_ptr_remove(branch->right, i-left_len);
+}
+
+static void cursor_next_leaf(list_cursor *c) {
+    while (c->path[c->depth - 1].right) {
+        c->depth -= 1;
+    }
+    list_step *step = &c->path[c->depth - 1];
+    step->right = true;
+    cursor_descend(c, step->branch->data.branch.right, 0);
+}
+
+static void cursor_prev_leaf(list_cursor *c) {
+    while (!c->path[c->depth - 1].right) {
+        c->depth -= 1;
+    }
+    list_step *step = &c->path[c->depth - 1];
+    step->right = false;
+    list *left = step->branch->data.branch.left;
+    cursor_descend(c, left, node_length(left) - 1);
+}
+
+/* returns the next element, borrowed from the list, or NULL at the end */
+object *list_cursor_next(list_cursor *c) {
+    if (c->remaining == 0) {
+        return NULL;
+    }
+    c->remaining -= 1;
+    object *obj;
+    if (c->leaf == NULL) {
+        obj = c->head->vec[c->pos];
+        c->pos += c->reverse ? -1 : 1;
+        return obj;
+    }
+    obj = c->leaf->data.leaf.items[c->pos];
+    if (c->remaining == 0) {
+        return obj;
+    }
+    if (c->reverse) {
+        if (--c->pos < 0) {
+            cursor_prev_leaf(c);
+        }
     } else {
-        branch->left = list_ptr_remove(branch->left, i);
-        if (branch->left == NULL) {
-            branch->left = branch->right;
-            branch->right = NULL;
+        if (++c->pos == c->leaf->data.leaf.count) {
+            cursor_next_leaf(c);
         }
     }
-    branch->nodes -= 1;
+    return obj;
 }
 
-list *list_copy(list *l) {
-    if (l == NULL) {
-        return NULL;
+/*
+ * copies up to n elements starting at i into out, descending the tree once
+ * and then copying whole runs of each leaf. the elements are borrowed from
+ * the list if borrow is set. returns the number of elements copied
+ */
+int32_t list_get_range
+        (list_head *head, int32_t i, int32_t n, object **out, bool borrow) {
+    int32_t len = list_length(head);
+    assert(i >= 0 && i <= len && n >= 0);
+    if (n > len - i) {
+        n = len - i;
     }
-    list *res = malloc(sizeof(list));
-    res->type = l->type;
-    if (l->type == LEAF) {
-        res->data.leaf = object_copy(l->data.leaf);
+    if (n == 0) {
+        return 0;
+    }
+    if (head->root == NULL) {
+        memcpy(out, &head->vec[i], sizeof(object *) * n);
     } else {
-        res->data.branch.nodes = l->data.branch.nodes;
-        res->data.branch.left = list_copy(l->data.branch.left);
-        res->data.branch.right = list_copy(l->data.branch.right);
+        list_cursor c;
+        list_cursor_init(&c, head, i, false);
+        int32_t done = 0;
+        while (1) {
+            int32_t run = c.leaf->data.leaf.count - c.pos;
+            if (run > n - done) {
+                run = n - done;
+            }
+            memcpy(&out[done], &c.leaf->data.leaf.items[c.pos],
+                   sizeof(object *) * run);
+            done += run;
+            if (done == n) {
+                break;
+            }
+            cursor_next_leaf(&c);
+        }
     }
-    return res;
+    if (!borrow) {
+        int32_t j;
+        for (j = 0; j < n; ++j) {
+            out[j] = object_copy(out[j]);
+        }
+    }
+    return n;
 }
@@ -21,34 +21,105 @@
 #define LIST_H
 
 #include "stdint.h"
+#include "stdbool.h"
 
 #include "object.h"
 
 #define BRANCH 1
 #define LEAF 2
 
+/* the number of elements a single leaf can hold */
+#define LIST_CHUNK 32
+/* a bound on the height of a balanced tree of INT32_MAX elements */
+#define LIST_DEPTH 48
+
 struct list;
 
 struct finger_branch {
     struct list *left, *right;
-    int64_t nodes;
+    /* the number of elements below this branch */
+    int32_t nodes;
+    /* the length of the longest path to a leaf, leaves have height 1 */
+    int32_t height;
 };
 typedef struct finger_branch finger_branch;
 
+struct list_chunk {
+    int32_t count;
+    object *items[LIST_CHUNK];
+};
+typedef struct list_chunk list_chunk;
+
+/*
+ * branches are allocated without the space for a chunk. nodes are reference
+ * counted and shared between copies of a list, they're copied on write
+ */
 struct list {
     unsigned char type;
+    unsigned int ref;
     union {
         finger_branch branch;
-        object *leaf;
+        list_chunk leaf;
     } data;
 };
 typedef struct list list;
 
-void list_set(finger_branch *, int32_t, object *);
-void list_insert_at(finger_branch *, int32_t, object *);
-void list_remove(finger_branch *, int32_t);
-object *list_get(finger_branch *, int32_t);
-int32_t list_length(finger_branch *);
-list *list_copy(list *);
+/*
+ * lists start out as a plain growable array and are moved into a tree the
+ * first time an element is inserted or removed anywhere but at the end. the
+ * tree is kept height balanced (AVL), so the heights of the two children of
+ * any branch differ by at most one and every operation is O(log n)
+ */
+struct list_head {
+    /* the dense representation, used while root is NULL */
+    object **vec;
+    int32_t len;
+    int32_t cap;
+    list *root;
+};
+typedef struct list_head list_head;
+
+struct list_step {
+    list *branch;
+    /* whether the path continues to the right of the branch */
+    bool right;
+};
+typedef struct list_step list_step;
+
+/*
+ * walks the elements of a list in either direction, keeping the path to the
+ * current leaf so that moving to the next leaf is amortized O(1). the list
+ * must not be changed while a cursor is in use
+ */
+struct list_cursor {
+    list_head *head;
+    /* the number of elements left to visit */
+    int32_t remaining;
+    bool reverse;
+    /* the leaf being read, NULL for a dense list */
+    list *leaf;
+    /* the position of the next element in the leaf or the dense array */
+    int32_t pos;
+    int depth;
+    list_step path[LIST_DEPTH];
+};
+typedef struct list_cursor list_cursor;
+
+void list_init(list_head *);
+void list_set(list_head *, int32_t, object *);
+void list_insert_at(list_head *, int32_t, object *);
+void list_remove(list_head *, int32_t);
+object *list_get(list_head *, int32_t);
+int32_t list_length(list_head *);
+void list_push(list_head *, object *);
+void list_push_array(list_head *, object **, int32_t);
+void list_clear(list_head *);
+void list_copy(list_head *, list_head *);
+void list_concat(list_head *, list_head *, list_head *);
+void list_split(list_head *, int32_t, list_head *, list_head *);
+void list_slice(list_head *, int32_t, int32_t, list_head *);
+void list_cursor_init(list_cursor *, list_head *, int32_t, bool);
+object *list_cursor_next(list_cursor *);
+int32_t list_get_range(list_head *, int32_t, int32_t, object **, bool);
 
 #endif
@@ -18,148 +18,665 @@
 */
 
 #include "stdlib.h"
+#include "string.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "map.h"
+#include "mem.h"
+
+struct map_shape {
+    unsigned int ref;
+    /* record i of keys holds the key of slot i, the values are none */
+    map keys;
+    /*
+     * the key looked up last and its slot. the key isn't referenced and may be
+     * gone, or another key may have its address since, so it's only compared
+     * by address and a hit is checked against the key in the slot
+     */
+    object *last;
+    uint32_t last_slot;
+};
 
-#define HASH_TRIES 5
+/* object_hash is keyed and already well mixed */
+static uint32_t map_hash(object *key) {
+    return object_hash(key);
+}
 
-static uint32_t hash(uint32_t a){
-   a = (a+0x7ed55d16) + (a<<12);
-   a = (a^0xc761c23c) ^ (a>>19);
-   a = (a+0x165667b1) + (a<<5);
-   a = (a+0xd3a2646c) ^ (a<<9);
-   a = (a+0xfd7046c5) + (a<<3);
-   a = (a^0xb55a4f09) ^ (a>>16);
-   return a;
+/* the slots of a group whose control byte equals c, one bit per slot */
+static uint32_t group_match(const uint8_t *ctrl, uint8_t c) {
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((const __m128i *) ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(c)));
+#else
+    uint32_t res = 0;
+    int i;
+    for (i = 0; i < MAP_GROUP; ++i) {
+        if (ctrl[i] == c) {
+            res |= 1u << i;
+        }
+    }
+    return res;
+#endif
+}
+
+/* the slots of a group that are empty or deleted */
+static uint32_t group_match_free(const uint8_t *ctrl) {
+#ifdef __SSE2__
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) ctrl));
+#else
+    uint32_t res = 0;
+    int i;
+    for (i = 0; i < MAP_GROUP; ++i) {
+        if (ctrl[i] & 0x80) {
+            res |= 1u << i;
+        }
+    }
+    return res;
+#endif
 }
 
-static void map_resize(map *m, uint32_t sz) {
-    map new;
-    map_init(&new, sz);
+static uint32_t lowest_bit(uint32_t mask) {
+#ifdef __GNUC__
+    return __builtin_ctz(mask);
+#else
+    uint32_t i = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        ++i;
+    }
+    return i;
+#endif
+}
+
+static uint8_t *map_ctrl(map *m) {
+    return (uint8_t *) &m->index[m->sz];
+}
+
+static uint32_t map_groups(map *m) {
+    return m->sz / MAP_GROUP;
+}
+
+/*
+ * groups are probed in triangular steps from the one picked by the upper
+ * bits of the hash, which visits every group once as their number is a power
+ * of two. a group with an empty slot ends the search. returns the index slot
+ */
+static int64_t map_find(map *m, object *key, uint32_t key_hash) {
+    uint32_t mask = map_groups(m) - 1;
+    uint32_t g = (key_hash >> 7) & mask;
+    uint32_t step;
+    for (step = 1; step <= map_groups(m); ++step) {
+        const uint8_t *ctrl = &map_ctrl(m)[g * MAP_GROUP];
+        uint32_t match = group_match(ctrl, key_hash & 0x7f);
+        while (match) {
+            uint32_t i = g * MAP_GROUP + lowest_bit(match);
+            record *rec = &m->data[m->index[i]];
+            if (rec->hash == key_hash && object_eq(key, rec->key)) {
+                return i;
+            }
+            match &= match - 1;
+        }
+        if (group_match(ctrl, MAP_EMPTY)) {
+            return -1;
+        }
+        g = (g + step) & mask;
+    }
+    return -1;
+}
+
+/* the first free slot on the probe sequence of a hash */
+static uint32_t map_find_free(map *m, uint32_t key_hash) {
+    uint32_t mask = map_groups(m) - 1;
+    uint32_t g = (key_hash >> 7) & mask;
+    uint32_t step;
+    for (step = 1; ; ++step) {
+        uint32_t match = group_match_free(&map_ctrl(m)[g * MAP_GROUP]);
+        if (match) {
+            return g * MAP_GROUP + lowest_bit(match);
+        }
+        g = (g + step) & mask;
+    }
+}
+
+static void map_index_record(map *m, uint32_t pos) {
+    uint32_t key_hash = m->data[pos].hash;
+    uint32_t i = map_find_free(m, key_hash);
+    uint8_t *ctrl = map_ctrl(m);
+    if (ctrl[i] == MAP_DELETED) {
+        m->deleted -= 1;
+    }
+    ctrl[i] = key_hash & 0x7f;
+    m->index[i] = pos;
+}
+
+static uint32_t map_round_size(uint32_t sz) {
+    uint32_t res = MAP_GROUP;
+    while (res < sz) {
+        res *= 2;
+    }
+    return res;
+}
+
+static int64_t map_find_small(map *m, object *key) {
     uint32_t i;
-    for (i = 0; i < m->sz; ++i) {
-        record *rec = &new.data[i];
-        rec->key = NULL;
-        rec->val = NULL;
+    for (i = 0; i < m->used; ++i) {
+        if (object_eq(key, m->data[i].key)) {
+            return i;
+        }
     }
-    for (i = 0; i < m->sz; ++i) {
-        record *rec = &m->data[i];
-        if (rec->key != NULL) {
-            map_set(&new, rec->key, rec->val);
+    return -1;
+}
+
+/* squeezes out removed records */
+static void map_compact(map *m) {
+    uint32_t i, j = 0;
+    for (i = 0; i < m->used; ++i) {
+        if (m->data[i].key != NULL) {
+            m->data[j++] = m->data[i];
         }
     }
-    map_clear(m);
-    *m = new;
+    m->used = j;
+}
+
+/* the records are small and often reallocated, so they come from the slabs */
+static void map_resize_records(map *m, uint32_t cap) {
+    m->data = mem_slab_realloc(m->data, sizeof(record) * m->cap,
+            sizeof(record) * cap);
+    m->cap = cap;
 }
 
-static void map_upsize(map *m) {
-    map_resize(m, m->sz * 2);
+static void map_free_records(map *m) {
+    mem_slab_free(m->data, sizeof(record) * m->cap);
+    m->data = NULL;
+    m->cap = 0;
 }
 
-static void map_downsize(map *m) {
-    if (m->sz / 2 >= 16) {
-        map_resize(m, m->sz / 2);
+/* compacts the records and rebuilds the index with sz slots */
+static void map_reindex(map *m, uint32_t sz) {
+    uint32_t i;
+    map_compact(m);
+    mem_free(m->index);
+    m->sz = map_round_size(sz);
+    m->index = mem_alloc((sizeof(uint32_t) + 1) * m->sz);
+    memset(map_ctrl(m), MAP_EMPTY, m->sz);
+    m->deleted = 0;
+    for (i = 0; i < m->used; ++i) {
+        map_index_record(m, i);
+    }
+}
+
+/*
+ * the number of index slots for n elements. the index grows past 7/8 full
+ * and shrinks under 1/4, so a freshly sized index has room both ways
+ */
+static uint32_t map_index_size(uint32_t n) {
+    return map_round_size((n * 8 + 6) / 7);
+}
+
+/* hashes the keys of a small map and gives it an index of sz slots */
+static void map_upgrade(map *m, uint32_t sz) {
+    uint32_t i;
+    for (i = 0; i < m->used; ++i) {
+        m->data[i].hash = map_hash(m->data[i].key);
+    }
+    map_reindex(m, sz);
+}
+
+/* the position of the record of key, -1 if it's not in the map */
+static int64_t map_position(map *m, object *key) {
+    if (m->index == NULL) {
+        return map_find_small(m, key);
+    }
+    int64_t i = map_find(m, key, map_hash(key));
+    if (i < 0) {
+        return -1;
     }
+    return m->index[i];
+}
+
+static int64_t map_shape_slot(map_shape *s, object *key) {
+    if (key == s->last &&
+            object_eq(key, s->keys.data[s->last_slot].key)) {
+        return s->last_slot;
+    }
+    int64_t slot = map_position(&s->keys, key);
+    if (slot >= 0) {
+        s->last = key;
+        s->last_slot = slot;
+    }
+    return slot;
+}
+
+/* turns a shaped map into a normal one with the same records */
+static void map_unshape(map *m) {
+    map_shape *s = m->shape;
+    object **vals = m->vals;
+    uint32_t n = m->elems;
+    uint32_t j;
+    map_init(m, n);
+    for (j = 0; j < n; ++j) {
+        map_put(m, object_copy(s->keys.data[j].key), vals[j]);
+    }
+    mem_free(vals);
+    map_shape_release(s);
 }
 
 void map_copy(map *src, map *dst) {
-    dst->sz = src->sz;
-    dst->elems = src->elems;
-    dst->data = malloc(sizeof(record) * src->sz);
+    if (src->persistent) {
+        *dst = *src;
+        if (dst->trie != NULL) {
+            dst->trie->ref += 1;
+        }
+        return;
+    }
+    map_init(dst, 0);
+    if (src->shape != NULL) {
+        object **vals = mem_alloc(sizeof(object *) * src->elems);
+        uint32_t j;
+        for (j = 0; j < src->elems; ++j) {
+            vals[j] = object_copy(src->vals[j]);
+        }
+        map_init_shaped(dst, map_shape_copy(src->shape), vals);
+        return;
+    }
+    map_resize_records(dst, src->elems);
     uint32_t i;
-    for (i = 0; i < src->sz; ++i) {
-        record *src_rec = &src->data[i];
-        record *dst_rec = &dst->data[i];
-        if (src_rec->key == NULL) {
-            dst_rec->key = NULL;
-            dst_rec->val = NULL;
-        } else {
-            dst_rec->key = object_copy(src_rec->key);
-            dst_rec->val = object_copy(src_rec->val);
+    for (i = 0; i < src->used; ++i) {
+        record *rec = &src->data[i];
+        if (rec->key != NULL) {
+            record *copy = &dst->data[dst->used++];
+            copy->key = object_copy(rec->key);
+            copy->val = object_copy(rec->val);
+            copy->hash = rec->hash;
         }
     }
+    dst->elems = dst->used;
+    if (src->index != NULL) {
+        map_reindex(dst, src->sz);
+    }
 }
 
-void map_init(map *m, uint32_t sz) {
-    m->sz = sz;
+/* a map with room for n elements */
+void map_init(map *m, uint32_t n) {
+    m->persistent = false;
+    m->shape = NULL;
+    m->data = NULL;
+    m->used = 0;
+    m->cap = 0;
+    m->index = NULL;
+    m->sz = 0;
     m->elems = 0;
-    m->data = malloc(sizeof(record) * sz);
-    uint32_t i;
-    for (i = 0; i < sz; ++i) {
-        m->data[i].key = NULL;
-        m->data[i].val = NULL;
+    m->deleted = 0;
+    map_reserve(m, n);
+}
+
+static void map_put_small(map *m, object *key, object *val) {
+    int64_t i = map_find_small(m, key);
+    if (i >= 0) {
+        object *old = m->data[i].val;
+        m->data[i].val = val;
+        object_free(old);
+        object_free(key);
+        return;
+    }
+    if (m->used == m->cap) {
+        map_resize_records(m, m->cap ? m->cap * 2 : 4);
     }
+    record *rec = &m->data[m->used++];
+    rec->key = key;
+    rec->val = val;
+    m->elems += 1;
 }
 
-void map_set(map *m, object *key, object *val) {
-    uint32_t key_hash = object_hash(key);
-    int i;
-    for (i = 0; i < HASH_TRIES; ++i) {
-        record *rec = &m->data[key_hash % m->sz];
-        if (rec->key == NULL) {
-            rec->key = object_copy(key);
-            rec->val = object_copy(val);
+/*
+ * copies of a persistent map share the trie, so copying is O(1) and a write
+ * copies only the O(log n) nodes on the path to the key
+ */
+void map_init_persistent(map *m) {
+    m->persistent = true;
+    m->shape = NULL;
+    m->trie = NULL;
+    m->used = 0;
+    m->cap = 0;
+    m->index = NULL;
+    m->sz = 0;
+    m->elems = 0;
+    m->deleted = 0;
+}
+
+/* like map_set, but takes over the references to key and val */
+void map_put(map *m, object *key, object *val) {
+    if (m->persistent) {
+        bool added;
+        m->trie = hamt_set(m->trie, key, val, &added);
+        if (added) {
             m->elems += 1;
+        }
+        object_free(key);
+        object_free(val);
+        return;
+    }
+    if (m->shape != NULL) {
+        int64_t slot = map_shape_slot(m->shape, key);
+        if (slot >= 0) {
+            object *old = m->vals[slot];
+            m->vals[slot] = val;
+            object_free(old);
+            object_free(key);
             return;
+        }
+        map_unshape(m);
+    }
+    if (m->index == NULL) {
+        if (m->elems < MAP_SMALL || map_find_small(m, key) >= 0) {
+            map_put_small(m, key, val);
+            return;
+        }
+        map_upgrade(m, map_index_size(MAP_SMALL + 1));
+    }
+    uint32_t key_hash = map_hash(key);
+    int64_t i = map_find(m, key, key_hash);
+    if (i >= 0) {
+        record *rec = &m->data[m->index[i]];
+        object *old = rec->val;
+        rec->val = val;
+        object_free(old);
+        object_free(key);
+        return;
+    }
+    /* the index is kept at most 7/8 full, counting deleted slots */
+    if ((m->elems + m->deleted + 1) * 8 > m->sz * 7) {
+        if ((m->elems + 1) * 16 > m->sz * 7) {
+            map_reindex(m, m->sz * 2);
         } else {
-            if (object_eq(key, rec->key)) {
-                object_free(rec->val);
-                rec->val = object_copy(val);
-                return;
-            }
+            map_reindex(m, m->sz);
+        }
+    }
+    if (m->used == m->cap) {
+        if (m->used - m->elems > m->used / 2) {
+            map_reindex(m, m->sz);
+        } else {
+            map_resize_records(m, m->cap ? m->cap * 2 : 4);
         }
-        key_hash = hash(key_hash);
     }
-    map_upsize(m);
-    map_set(m, key, val);
+    record *rec = &m->data[m->used];
+    rec->key = key;
+    rec->val = val;
+    rec->hash = key_hash;
+    map_index_record(m, m->used++);
+    m->elems += 1;
+}
+
+void map_set(map *m, object *key, object *val) {
+    map_put(m, object_copy(key), object_copy(val));
 }
 
 object *map_get(map *m, object *key) {
-    uint32_t key_hash = object_hash(key);
-    int i;
-    for (i = 0; i < HASH_TRIES; ++i) {
-        record *rec = &m->data[key_hash % m->sz];
-        if (object_eq(key, rec->key)) {
-            return object_copy(rec->val);
-        }
-        key_hash = hash(key_hash);
+    if (m->persistent) {
+        object *val = hamt_get(m->trie, key);
+        return val == NULL ? NULL : object_copy(val);
+    }
+    if (m->shape != NULL) {
+        int64_t slot = map_shape_slot(m->shape, key);
+        return slot < 0 ? NULL : object_copy(m->vals[slot]);
     }
-    return NULL;
+    if (m->index == NULL) {
+        int64_t i = map_find_small(m, key);
+        return i < 0 ? NULL : object_copy(m->data[i].val);
+    }
+    int64_t i = map_find(m, key, map_hash(key));
+    if (i < 0) {
+        return NULL;
+    }
+    return object_copy(m->data[m->index[i]].val);
 }
 
 void map_rem(map *m, object *key) {
-    uint32_t key_hash = object_hash(key);
-    int i;
-    for (i = 0; i < HASH_TRIES; ++i) {
-        record *rec = &m->data[key_hash % m->sz];
-        if (object_eq(key, rec->key)) {
-            object_free(rec->key);
-            object_free(rec->val);
-            rec->key = NULL;
-            rec->val = NULL;
+    if (m->persistent) {
+        bool removed;
+        m->trie = hamt_rem(m->trie, key, &removed);
+        if (removed) {
+            m->elems -= 1;
+        }
+        return;
+    }
+    if (m->shape != NULL) {
+        if (map_shape_slot(m->shape, key) < 0) {
+            return;
+        }
+        map_unshape(m);
+    }
+    if (m->index == NULL) {
+        /* small maps have no holes, the records after it move down */
+        int64_t i = map_find_small(m, key);
+        if (i >= 0) {
+            object_free(m->data[i].key);
+            object_free(m->data[i].val);
+            memmove(&m->data[i], &m->data[i + 1],
+                    sizeof(record) * (m->used - i - 1));
+            m->used -= 1;
             m->elems -= 1;
-            if (m->elems * 4 < m->sz) {
-                map_downsize(m);
-            }
         }
-        key_hash = hash(key_hash);
+        return;
+    }
+    int64_t i = map_find(m, key, map_hash(key));
+    if (i < 0) {
+        return;
+    }
+    record *rec = &m->data[m->index[i]];
+    object_free(rec->key);
+    object_free(rec->val);
+    rec->key = NULL;
+    rec->val = NULL;
+    /*
+     * a probe only moves past a group without empty slots, so if this group
+     * still has one no probe can have passed it and the slot can be emptied
+     */
+    uint8_t *ctrl = map_ctrl(m);
+    if (group_match(&ctrl[i - i % MAP_GROUP], MAP_EMPTY)) {
+        ctrl[i] = MAP_EMPTY;
+    } else {
+        ctrl[i] = MAP_DELETED;
+        m->deleted += 1;
+    }
+    m->elems -= 1;
+    if (m->elems * 4 < m->sz && m->sz > MAP_GROUP) {
+        map_reindex(m, m->sz / 2);
     }
 }
 
 void map_clear(map *m) {
+    if (m->persistent) {
+        hamt_release(m->trie);
+        m->trie = NULL;
+        m->elems = 0;
+        return;
+    }
     uint32_t i;
-    for (i = 0; i < m->sz; ++i) {
-        record *rec = &m->data[i];
-        if (rec->key != NULL) {
-            object_free(rec->key);
-            object_free(rec->val);
-            rec->key = NULL;
-            rec->val = NULL;
+    if (m->shape != NULL) {
+        for (i = 0; i < m->elems; ++i) {
+            object_free(m->vals[i]);
         }
+        mem_free(m->vals);
+        map_shape_release(m->shape);
+        m->vals = NULL;
+        m->shape = NULL;
     }
+    for (i = 0; i < m->used; ++i) {
+        if (m->data[i].key != NULL) {
+            object_free(m->data[i].key);
+            object_free(m->data[i].val);
+        }
+    }
+    if (m->index != NULL) {
+        memset(map_ctrl(m), MAP_EMPTY, m->sz);
+    }
+    m->used = 0;
     m->elems = 0;
+    m->deleted = 0;
+}
+
+void map_free(map *m) {
+    map_clear(m);
+    map_free_records(m);
+    mem_free(m->index);
+}
+
+/* makes room for n elements without growing again */
+void map_reserve(map *m, uint32_t n) {
+    if (m->persistent || n <= m->elems) {
+        return;
+    }
+    if (m->shape != NULL) {
+        map_unshape(m);
+    }
+    if (n > MAP_SMALL) {
+        if (m->index == NULL) {
+            map_upgrade(m, map_index_size(n));
+        } else if (n * 8 > m->sz * 7) {
+            map_reindex(m, map_index_size(n));
+        }
+    }
+    if (m->cap < m->used + (n - m->elems)) {
+        map_resize_records(m, m->used + (n - m->elems));
+    }
+}
+
+/* gives back the memory the map doesn't need for its current elements */
+void map_shrink_to_fit(map *m) {
+    if (m->persistent || m->shape != NULL) {
+        return;
+    }
+    if (m->elems <= MAP_SMALL) {
+        map_compact(m);
+        mem_free(m->index);
+        m->index = NULL;
+        m->sz = 0;
+        m->deleted = 0;
+    } else {
+        map_reindex(m, map_index_size(m->elems));
+    }
+    if (m->elems == 0) {
+        map_free_records(m);
+    } else {
+        map_resize_records(m, m->elems);
+    }
 }
 
 uint32_t map_length(map *m) {
     return m->elems;
 }
+
+void map_cursor_init(map *m, map_cursor *c) {
+    c->pos = 0;
+    if (m->persistent) {
+        hamt_cursor_init(&c->trie, m->trie);
+    }
+}
+
+/* the key and value are borrowed from the map */
+bool map_cursor_next(map *m, map_cursor *c, object **key, object **val) {
+    if (m->persistent) {
+        return hamt_cursor_next(&c->trie, key, val);
+    }
+    if (m->shape != NULL) {
+        if (c->pos >= m->elems) {
+            return false;
+        }
+        *key = m->shape->keys.data[c->pos].key;
+        *val = m->vals[c->pos++];
+        return true;
+    }
+    while (c->pos < m->used) {
+        record *rec = &m->data[c->pos++];
+        if (rec->key != NULL) {
+            *key = rec->key;
+            *val = rec->val;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* takes over the reference to the shape and the values */
+void map_init_shaped(map *m, map_shape *s, object **vals) {
+    map_init(m, 0);
+    m->shape = s;
+    m->vals = vals;
+    m->elems = s->keys.elems;
+}
+
+/* a shape with the keys of m in order, NULL if m can't have one */
+map_shape *map_shape_new(map *m) {
+    if (m->persistent || m->elems == 0) {
+        return NULL;
+    }
+    if (m->shape != NULL) {
+        return map_shape_copy(m->shape);
+    }
+    map_shape *s = mem_alloc(sizeof(map_shape));
+    s->ref = 1;
+    s->last = NULL;
+    s->last_slot = 0;
+    map_init(&s->keys, m->elems);
+    uint32_t i;
+    for (i = 0; i < m->used; ++i) {
+        if (m->data[i].key != NULL) {
+            map_set(&s->keys, m->data[i].key, object_none());
+        }
+    }
+    return s;
+}
+
+/*
+ * moves the values of m into a shaped map if it has the keys of the shape in
+ * the same order
+ */
+bool map_use_shape(map *m, map_shape *s) {
+    if (m->persistent || m->shape != NULL || m->elems != s->keys.elems) {
+        return m->shape == s;
+    }
+    uint32_t i, j = 0;
+    for (i = 0; i < m->used; ++i) {
+        if (m->data[i].key != NULL) {
+            if (!object_eq(m->data[i].key, s->keys.data[j++].key)) {
+                return false;
+            }
+        }
+    }
+    object **vals = mem_alloc(sizeof(object *) * m->elems);
+    for (i = 0, j = 0; i < m->used; ++i) {
+        if (m->data[i].key != NULL) {
+            object_free(m->data[i].key);
+            vals[j++] = m->data[i].val;
+        }
+    }
+    map_free_records(m);
+    mem_free(m->index);
+    map_init_shaped(m, map_shape_copy(s), vals);
+    return true;
+}
+
+map_shape *map_shape_copy(map_shape *s) {
+    s->ref += 1;
+    return s;
+}
+
+uint32_t map_shape_length(map_shape *s) {
+    return s->keys.elems;
+}
+
+object *map_shape_key(map_shape *s, uint32_t i) {
+    return s->keys.data[i].key;
+}
+
+void map_shape_release(map_shape *s) {
+    if (--s->ref > 0) {
+        return;
+    }
+    map_free(&s->keys);
+    mem_free(s);
+}
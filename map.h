@@ -21,28 +21,100 @@
 #define MAP_H
 
 #include "object.h"
+#include "hamt.h"
 
 struct record {
     object *key;
     object *val;
+    /*
+     * the full hash of key, so resizing never hashes a key again. unset
+     * while the map is small
+     */
+    uint32_t hash;
 };
 typedef struct record record;
 
+/*
+ * records are kept in insertion order in a dense array, and found through an
+ * open addressing index that's probed a group of MAP_GROUP slots at a time.
+ * each index slot has a control byte that's either MAP_EMPTY, MAP_DELETED or
+ * the low 7 bits of the hash of its key, so a whole group can be matched at
+ * once, and the position of its record in the array
+ */
+#define MAP_GROUP 16
+#define MAP_EMPTY 0x80
+#define MAP_DELETED 0xfe
+
+/*
+ * maps of up to MAP_SMALL elements have no index and are scanned linearly,
+ * without hashing their keys
+ */
+#define MAP_SMALL 8
+
+/*
+ * a key layout shared by maps with the same keys in the same order, such as
+ * the records of a JSON array. a map using a shape stores only its values
+ */
+struct map_shape;
+typedef struct map_shape map_shape;
+
 struct map {
-    record *data;
+    union {
+        /* the records, removed ones are left in place with a NULL key */
+        record *data;
+        /*
+         * shaped maps keep their values in the order of the keys of the
+         * shape and have no records. any change to the keys makes a normal
+         * map
+         */
+        object **vals;
+        /* persistent maps keep their records in a trie */
+        hamt_node *trie;
+    };
+    /* NULL while the map is small, followed by the control bytes */
+    uint32_t *index;
+    map_shape *shape;
+    /* the number of records in data, including removed ones */
+    uint32_t used;
     /* the number of records in the allocation */
+    uint32_t cap;
+    /* the number of slots in the index, a power of two */
     uint32_t sz;
     /* the number of elements in the map */
     uint32_t elems;
+    /* the number of MAP_DELETED control bytes */
+    uint32_t deleted;
+    bool persistent;
 };
 typedef struct map map;
 
+struct map_cursor {
+    uint32_t pos;
+    hamt_cursor trie;
+};
+typedef struct map_cursor map_cursor;
+
 void map_init(map *, uint32_t);
+void map_init_persistent(map *);
+void map_init_shaped(map *, map_shape *, object **);
 void map_set(map *, object *, object *);
+void map_put(map *, object *, object *);
 object *map_get(map *, object *);
 void map_rem(map *, object *);
 void map_clear(map *);
+void map_free(map *);
+void map_reserve(map *, uint32_t);
+void map_shrink_to_fit(map *);
 void map_copy(map *, map *);
 uint32_t map_length(map *);
+void map_cursor_init(map *, map_cursor *);
+bool map_cursor_next(map *, map_cursor *, object **, object **);
+
+map_shape *map_shape_new(map *);
+map_shape *map_shape_copy(map_shape *);
+bool map_use_shape(map *, map_shape *);
+uint32_t map_shape_length(map_shape *);
+object *map_shape_key(map_shape *, uint32_t);
+void map_shape_release(map_shape *);
 
 #endif
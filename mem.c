@@ -0,0 +1,302 @@
+/*  
+    Copyright (C) 2011 Butterfly authors,
+    
+    This file is part of Butterfly.
+    
+    Butterfly is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Butterfly is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stdint.h"
+#include "stdlib.h"
+#include "string.h"
+
+#include "mem.h"
+
+#ifdef BUTTERFLY_SLAB
+#include "pthread.h"
+#endif
+
+#ifdef __GNUC__
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL
+#endif
+
+static THREAD_LOCAL arena *current = NULL;
+
+static void *default_malloc(void *ctx, size_t n) {
+    (void) ctx;
+    return malloc(n);
+}
+
+static void *default_realloc(void *ctx, void *p, size_t n) {
+    (void) ctx;
+    return realloc(p, n);
+}
+
+static void default_free(void *ctx, void *p) {
+    (void) ctx;
+    free(p);
+}
+
+static butterfly_malloc_fn sys_malloc = default_malloc;
+static butterfly_realloc_fn sys_realloc = default_realloc;
+static butterfly_free_fn sys_free = default_free;
+static void *sys_ctx = NULL;
+
+void butterfly_set_allocator(butterfly_malloc_fn malloc_fn,
+        butterfly_realloc_fn realloc_fn, butterfly_free_fn free_fn,
+        void *ctx) {
+    if (malloc_fn == NULL || realloc_fn == NULL || free_fn == NULL) {
+        malloc_fn = default_malloc;
+        realloc_fn = default_realloc;
+        free_fn = default_free;
+        ctx = NULL;
+    }
+    sys_malloc = malloc_fn;
+    sys_realloc = realloc_fn;
+    sys_free = free_fn;
+    sys_ctx = ctx;
+}
+
+void *mem_sys_alloc(size_t n) {
+    return sys_malloc(sys_ctx, n);
+}
+
+void *mem_sys_realloc(void *p, size_t n) {
+    if (p == NULL) {
+        return sys_malloc(sys_ctx, n);
+    }
+    return sys_realloc(sys_ctx, p, n);
+}
+
+void mem_sys_free(void *p) {
+    if (p != NULL) {
+        sys_free(sys_ctx, p);
+    }
+}
+
+#ifdef BUTTERFLY_SLAB
+
+/*
+ * blocks up to SLAB_MAX bytes are rounded up to a multiple of SLAB_STEP and
+ * carved from pages of SLAB_PAGE bytes, so blocks of a size sit next to each
+ * other. freed blocks go on the free list of the freeing thread. pages are
+ * never given back, the free lists of a finished thread go to a shared depot
+ * that other threads refill from
+ */
+#define SLAB_STEP 16
+#define SLAB_MAX 512
+#define SLAB_CLASSES (SLAB_MAX / SLAB_STEP)
+#define SLAB_PAGE 65536
+
+struct slab_block {
+    struct slab_block *next;
+};
+
+typedef struct slab_block slab_block;
+
+static THREAD_LOCAL slab_block *free_lists[SLAB_CLASSES];
+static slab_block *depot[SLAB_CLASSES];
+static pthread_mutex_t depot_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t thread_key;
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+
+static size_t slab_class(size_t n) {
+    return (n - 1) / SLAB_STEP;
+}
+
+static void slab_thread_exit(void *unused) {
+    (void) unused;
+    size_t c;
+    pthread_mutex_lock(&depot_lock);
+    for (c = 0; c < SLAB_CLASSES; ++c) {
+        slab_block *last = free_lists[c];
+        if (last == NULL) {
+            continue;
+        }
+        while (last->next != NULL) {
+            last = last->next;
+        }
+        last->next = depot[c];
+        depot[c] = free_lists[c];
+        free_lists[c] = NULL;
+    }
+    pthread_mutex_unlock(&depot_lock);
+}
+
+static void slab_key_init() {
+    pthread_key_create(&thread_key, slab_thread_exit);
+}
+
+static slab_block *slab_refill(size_t c) {
+    pthread_once(&thread_key_once, slab_key_init);
+    /* any non NULL value makes the key call slab_thread_exit */
+    pthread_setspecific(thread_key, free_lists);
+    pthread_mutex_lock(&depot_lock);
+    slab_block *res = depot[c];
+    depot[c] = NULL;
+    pthread_mutex_unlock(&depot_lock);
+    if (res != NULL) {
+        return res;
+    }
+    size_t size = (c + 1) * SLAB_STEP;
+    char *page = mem_sys_alloc(SLAB_PAGE);
+    if (page == NULL) {
+        return NULL;
+    }
+    size_t i, count = SLAB_PAGE / size;
+    for (i = 0; i < count; ++i) {
+        slab_block *b = (slab_block *) (page + i * size);
+        b->next = i + 1 < count ? (slab_block *) (page + (i + 1) * size) : NULL;
+    }
+    return (slab_block *) page;
+}
+
+static void *heap_alloc(size_t n) {
+    if (n == 0 || n > SLAB_MAX) {
+        return mem_sys_alloc(n);
+    }
+    size_t c = slab_class(n);
+    slab_block *b = free_lists[c];
+    if (b == NULL) {
+        b = slab_refill(c);
+        if (b == NULL) {
+            return NULL;
+        }
+    }
+    free_lists[c] = b->next;
+    return b;
+}
+
+static void heap_free(void *p, size_t n) {
+    if (n == 0 || n > SLAB_MAX) {
+        mem_sys_free(p);
+        return;
+    }
+    size_t c = slab_class(n);
+    slab_block *b = p;
+    b->next = free_lists[c];
+    free_lists[c] = b;
+}
+
+static void *heap_realloc(void *p, size_t old, size_t n) {
+    if (p == NULL) {
+        return heap_alloc(n);
+    }
+    if (old > SLAB_MAX && n > SLAB_MAX) {
+        return mem_sys_realloc(p, n);
+    }
+    if (old != 0 && n != 0 && old <= SLAB_MAX && n <= SLAB_MAX &&
+            slab_class(old) == slab_class(n)) {
+        return p;
+    }
+    void *res = heap_alloc(n);
+    if (res != NULL) {
+        memcpy(res, p, old < n ? old : n);
+        heap_free(p, old);
+    }
+    return res;
+}
+
+#else
+
+static void *heap_alloc(size_t n) {
+    return mem_sys_alloc(n);
+}
+
+static void heap_free(void *p, size_t n) {
+    (void) n;
+    mem_sys_free(p);
+}
+
+static void *heap_realloc(void *p, size_t old, size_t n) {
+    (void) old;
+    return mem_sys_realloc(p, n);
+}
+
+#endif
+
+arena *mem_use_arena(arena *a) {
+    arena *prev = current;
+    current = a;
+    return prev;
+}
+
+arena *mem_arena() {
+    return current;
+}
+
+void *mem_alloc(size_t n) {
+    if (current != NULL) {
+        return arena_alloc(current, n);
+    }
+    return mem_sys_alloc(n);
+}
+
+void *mem_calloc(size_t n, size_t size) {
+    if (current != NULL) {
+        void *res = arena_alloc(current, n * size);
+        memset(res, 0, n * size);
+        return res;
+    }
+    if (size != 0 && n > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *res = mem_sys_alloc(n * size);
+    if (res != NULL) {
+        memset(res, 0, n * size);
+    }
+    return res;
+}
+
+void *mem_realloc(void *p, size_t n) {
+    if (current != NULL && (p == NULL || arena_owns(current, p))) {
+        void *res = arena_alloc(current, n);
+        if (p != NULL) {
+            size_t old = arena_size_of(p);
+            memcpy(res, p, old < n ? old : n);
+        }
+        return res;
+    }
+    return mem_sys_realloc(p, n);
+}
+
+void mem_free(void *p) {
+    if (current != NULL && (p == NULL || arena_owns(current, p))) {
+        return;
+    }
+    mem_sys_free(p);
+}
+
+void *mem_slab_alloc(size_t n) {
+    if (current != NULL) {
+        return arena_alloc(current, n);
+    }
+    return heap_alloc(n);
+}
+
+void *mem_slab_realloc(void *p, size_t old, size_t n) {
+    if (current != NULL && (p == NULL || arena_owns(current, p))) {
+        return mem_realloc(p, n);
+    }
+    return heap_realloc(p, old, n);
+}
+
+void mem_slab_free(void *p, size_t n) {
+    if (p == NULL || (current != NULL && arena_owns(current, p))) {
+        return;
+    }
+    heap_free(p, n);
+}
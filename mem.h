@@ -0,0 +1,68 @@
+/*  
+    Copyright (C) 2011 Butterfly authors,
+    
+    This file is part of Butterfly.
+    
+    Butterfly is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Butterfly is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MEM_H
+#define MEM_H
+
+#include "stddef.h"
+
+#include "arena.h"
+
+/*
+ * every allocation in the library goes through these. while a thread has an
+ * arena in use they come from the arena and freeing them does nothing
+ */
+void *mem_alloc(size_t);
+void *mem_calloc(size_t, size_t);
+void *mem_realloc(void *, size_t);
+void mem_free(void *);
+
+/*
+ * for the small blocks that come and go at a high rate: objects, list nodes
+ * and map records. the size has to be given back when freeing. built with
+ * BUTTERFLY_SLAB they come from per thread free lists of fixed sizes,
+ * otherwise these are the same as the calls above
+ */
+void *mem_slab_alloc(size_t);
+void *mem_slab_realloc(void *, size_t, size_t);
+void mem_slab_free(void *, size_t);
+
+/*
+ * where the library gets its memory from in the end, malloc, realloc and
+ * free by default. ctx is passed to every call. set the allocator before
+ * anything is allocated, memory from one allocator must not be given back to
+ * another. passing NULL functions restores the defaults
+ */
+typedef void *(*butterfly_malloc_fn)(void *ctx, size_t);
+typedef void *(*butterfly_realloc_fn)(void *ctx, void *, size_t);
+typedef void (*butterfly_free_fn)(void *ctx, void *);
+
+void butterfly_set_allocator(butterfly_malloc_fn, butterfly_realloc_fn,
+        butterfly_free_fn, void *ctx);
+
+/* the allocator set above, bypassing arenas and slabs */
+void *mem_sys_alloc(size_t);
+void *mem_sys_realloc(void *, size_t);
+void mem_sys_free(void *);
+
+/* returns the arena that was in use before */
+arena *mem_use_arena(arena *);
+arena *mem_arena();
+
+#endif
@@ -17,83 +17,243 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-/* for asprintf */
-#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <math.h>
+#include <pthread.h>
 
 #include "object.h"
 #include "list.h"
 #include "map.h"
+#include "hash.h"
+#include "mem.h"
+
+/* tagged values need the object pointer to have room for a double */
+#if defined(BUTTERFLY_TAGGED_VALUES) && UINTPTR_MAX == UINT64_MAX
+#define OBJECT_TAGGED
+#endif
+
+/* the string is in the atom table */
+#define OBJECT_INTERNED 1
+/* data.s.hash holds the hash of the string */
+#define OBJECT_HASHED 2
+/* the object is never freed and its ref isn't counted */
+#define OBJECT_STATIC 4
+/* the object was allocated from an arena and can't be changed */
+#define OBJECT_ARENA 8
 
 struct object {
     unsigned char type;
+    unsigned char flags;
     unsigned int ref;
     union {
-        finger_branch l;
+        list_head l;
         map m;
         int64_t n;
         double f;
-        char_t *str;
+        struct {
+            char_t *str;
+            uint32_t hash;
+        } s;
         unsigned char b;
     } data;
 };
 
 struct object_iterator {
     object *dst;
-    uint32_t pos;
+    union {
+        map_cursor m;
+        list_cursor l;
+    } cursor;
+    /* maps are read one record ahead, key is NULL at the end */
+    object *key;
+    object *val;
 };
 
-unsigned char none_type = OBJECT_NONE;
-
-#define none ((object *)&none_type)
-
-object bool_true = {OBJECT_BOOL, 0, { .b = true }};
-object bool_false = {OBJECT_BOOL, 0, { .b = false }};
+object none_object = {OBJECT_NONE, 0, 0, { .n = 0 }};
+
+#define none (&none_object)
+
+object bool_true = {OBJECT_BOOL, 0, 0, { .b = true }};
+object bool_false = {OBJECT_BOOL, 0, 0, { .b = false }};
+
+/*
+ * the atom table holds every interned string, without a reference, so an
+ * interned string leaves the table when it's freed. it's an open addressing
+ * table probed linearly and kept at most half full. every thread interns into
+ * the same table, so it's only touched with atoms_lock held, and interned
+ * strings count their references atomically
+ */
+static object **atoms = NULL;
+static uint32_t atoms_sz = 0;
+static uint32_t atoms_len = 0;
+static pthread_mutex_t atoms_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef __GNUC__
+#define atomic_inc(p) __atomic_add_fetch((p), 1, __ATOMIC_RELAXED)
+#define atomic_dec(p) __atomic_sub_fetch((p), 1, __ATOMIC_ACQ_REL)
+#else
+#define atomic_inc(p) (++*(p))
+#define atomic_dec(p) (--*(p))
+#endif
 
 #define object_true (&bool_true)
 #define object_false (&bool_false)
 
-object *object_map() {
-    object *obj = malloc(sizeof(object));
-    obj->type = OBJECT_MAP;
+/*
+ * objects made while an arena is in use belong to it. they're never freed on
+ * their own, and only object_detach copies one out of the arena
+ */
+static object *object_new(unsigned char type) {
+    object *obj = mem_slab_alloc(sizeof(object));
+    obj->type = type;
+    obj->flags = mem_arena() != NULL ? OBJECT_ARENA : 0;
     obj->ref = 1;
-    map_init(&obj->data.m, 16);
+    return obj;
+}
+
+object *object_map() {
+    return object_map_with_capacity(0);
+}
+
+/* a map with room for n elements before it has to grow */
+object *object_map_with_capacity(uint32_t n) {
+    object *obj = object_new(OBJECT_MAP);
+    map_init(&obj->data.m, n);
+    return obj;
+}
+
+object *object_map_persistent() {
+    object *obj = object_new(OBJECT_MAP);
+    map_init_persistent(&obj->data.m);
     return obj;
 }
 
 object *object_list() {
-    object *obj = malloc(sizeof(object));
-    obj->type = OBJECT_LIST;
-    obj->ref = 1;
-    obj->data.l.left = NULL;
-    obj->data.l.right = NULL;
-    obj->data.l.nodes = 0;
+    object *obj = object_new(OBJECT_LIST);
+    list_init(&obj->data.l);
     return obj;
 }
 
 object *object_str(char_t *str) {
-    object *obj = malloc(sizeof(object));
-    obj->type = OBJECT_STR;
-    obj->ref = 1;
-    obj->data.str = str_strdup(str);
+    object *obj = object_new(OBJECT_STR);
+    obj->data.s.str = str_strdup(str);
     return obj;
 }
 
+/* takes over str */
+static object *object_str_owned(char_t *str) {
+    object *obj = object_new(OBJECT_STR);
+    obj->data.s.str = str;
+    return obj;
+}
+
+/*
+ * with tagged values, ints that fit in 63 bits and most doubles are stored in
+ * the object pointer itself, which is never a real object as those are at
+ * least 4 byte aligned. ints are shifted up with the low bit set. doubles
+ * with an exponent near zero are rotated so the low two bits of the pointer
+ * are 10, the same encoding as ruby's flonums
+ */
+#ifdef OBJECT_TAGGED
+
+#define TAG_INT 1
+#define TAG_FLONUM 2
+#define FLONUM_ZERO 0x8000000000000002ull
+
+#define immediate(obj) (((uintptr_t) (obj)) & (TAG_INT | TAG_FLONUM))
+
+static uint64_t rotl3(uint64_t v) {
+    return (v << 3) | (v >> 61);
+}
+
+static uint64_t rotr3(uint64_t v) {
+    return (v >> 3) | (v << 61);
+}
+
+/* NULL if f doesn't fit in a pointer */
+static object *flonum(double f) {
+    uint64_t v;
+    memcpy(&v, &f, sizeof(v));
+    int bits = (v >> 60) & 7;
+    if (v != 0x3000000000000000ull && !((bits - 3) & ~1)) {
+        return (object *) (uintptr_t) ((rotl3(v) & ~1ull) | TAG_FLONUM);
+    }
+    if (v == 0) {
+        return (object *) (uintptr_t) FLONUM_ZERO;
+    }
+    return NULL;
+}
+
+static double flonum_get(object *obj) {
+    uint64_t v = (uintptr_t) obj;
+    double f;
+    if (v == FLONUM_ZERO) {
+        return 0.0;
+    }
+    v = rotr3((2 - (v >> 63)) | (v & ~3ull));
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+#else
+
+#define immediate(obj) 0
+
+/*
+ * without tagged values, the ints from BUTTERFLY_SMALL_INT_MIN to
+ * BUTTERFLY_SMALL_INT_MAX are static objects shared by everyone, filled in
+ * once by whichever thread needs them first
+ */
+#ifndef BUTTERFLY_SMALL_INT_MIN
+#define BUTTERFLY_SMALL_INT_MIN -1
+#endif
+#ifndef BUTTERFLY_SMALL_INT_MAX
+#define BUTTERFLY_SMALL_INT_MAX 1024
+#endif
+
+static object small_ints[BUTTERFLY_SMALL_INT_MAX - BUTTERFLY_SMALL_INT_MIN + 1];
+static pthread_once_t small_ints_once = PTHREAD_ONCE_INIT;
+
+static void small_ints_init() {
+    int64_t n;
+    for (n = BUTTERFLY_SMALL_INT_MIN; n <= BUTTERFLY_SMALL_INT_MAX; ++n) {
+        object *obj = &small_ints[n - BUTTERFLY_SMALL_INT_MIN];
+        obj->type = OBJECT_INT;
+        obj->flags = OBJECT_STATIC;
+        obj->ref = 0;
+        obj->data.n = n;
+    }
+}
+
+#endif
+
 object *object_int(int64_t n) {
-    object *obj = malloc(sizeof(object));
-    obj->type = OBJECT_INT;
-    obj->ref = 1;
+#ifdef OBJECT_TAGGED
+    if (n >= INT64_MIN / 2 && n <= INT64_MAX / 2) {
+        return (object *) (((uintptr_t) n << 1) | TAG_INT);
+    }
+#else
+    if (n >= BUTTERFLY_SMALL_INT_MIN && n <= BUTTERFLY_SMALL_INT_MAX) {
+        pthread_once(&small_ints_once, small_ints_init);
+        return &small_ints[n - BUTTERFLY_SMALL_INT_MIN];
+    }
+#endif
+    object *obj = object_new(OBJECT_INT);
     obj->data.n = n;
     return obj;
 }
 
 object *object_float(double f) {
-    object *obj = malloc(sizeof(object));
-    obj->type = OBJECT_FLOAT;
-    obj->ref = 1;
+#ifdef OBJECT_TAGGED
+    object *imm = flonum(f);
+    if (imm != NULL) {
+        return imm;
+    }
+#endif
+    object *obj = object_new(OBJECT_FLOAT);
     obj->data.f = f;
     return obj;
 }
@@ -110,56 +270,190 @@ object *object_bool(bool b) {
     }
 }
 
+/*
+ * the insides of a container come from where the container does, so changing
+ * a heap container while an arena is in use still allocates from the heap.
+ * returns the arena to go back to with mem_use_arena
+ */
+static arena *owner_enter(object *obj) {
+    if (obj->flags & OBJECT_ARENA) {
+        return mem_arena();
+    }
+    return mem_use_arena(NULL);
+}
+
 static object *object_list_copy(object *obj) {
-    object *res = malloc(sizeof(object));
-    res->type = OBJECT_LIST;
-    res->ref = 1;
-    res->data.l.right = list_copy(obj->data.l.right);
-    res->data.l.left = list_copy(obj->data.l.left);
-    res->data.l.nodes = obj->data.l.nodes;
+    arena *prev = owner_enter(obj);
+    object *res = object_new(OBJECT_LIST);
+    list_copy(&obj->data.l, &res->data.l);
+    mem_use_arena(prev);
     return res;
 }
 
 static object *object_map_copy(object *obj) {
-    object *res = malloc(sizeof(object));
-    res->type = OBJECT_MAP;
-    res->ref = 1;
+    arena *prev = owner_enter(obj);
+    object *res = object_new(OBJECT_MAP);
     
     map_copy(&obj->data.m, &res->data.m);
     
+    mem_use_arena(prev);
     return res;
 }
 
 int object_type(object *obj) {
+#ifdef OBJECT_TAGGED
+    if ((uintptr_t) obj & TAG_INT) {
+        return OBJECT_INT;
+    }
+    if ((uintptr_t) obj & TAG_FLONUM) {
+        return OBJECT_FLOAT;
+    }
+#endif
     return obj->type;
 }
 
 bool object_hashable(object *obj) {
-    return !(obj->type == OBJECT_LIST ||
-             obj->type == OBJECT_MAP ||
-             obj->type == OBJECT_FLOAT);
+    return !(object_type(obj) == OBJECT_LIST ||
+             object_type(obj) == OBJECT_MAP ||
+             object_type(obj) == OBJECT_FLOAT);
 }
 
 bool object_iterable(object *obj) {
-    return (obj->type == OBJECT_LIST ||
-            obj->type == OBJECT_MAP);
+    return (object_type(obj) == OBJECT_LIST ||
+            object_type(obj) == OBJECT_MAP);
+}
+
+static uint32_t hash_fold(uint64_t h) {
+    return (uint32_t) (h ^ (h >> 32));
 }
 
+static uint32_t str_hash(const char_t *str) {
+    size_t len = str_strlen(str);
+    return hash_fold(hash_bytes(str, len * sizeof(char_t)));
+}
+
+/* strings never change, so the hash is computed once */
 static uint32_t object_str_hash(object *obj) {
-    uint32_t out = 5381;
-    size_t len = str_strlen(obj->data.str);
-    size_t i;
-    
-    for (i = 0; i < len; ++i) {
-        out = out * 33 + obj->data.str[i];
+    if (!(obj->flags & OBJECT_HASHED)) {
+        obj->data.s.hash = str_hash(obj->data.s.str);
+        obj->flags |= OBJECT_HASHED;
+    }
+    return obj->data.s.hash;
+}
+
+/* the slot holding str, or the empty slot where it would go */
+static uint32_t atom_find(const char_t *str, uint32_t h) {
+    uint32_t mask = atoms_sz - 1;
+    uint32_t i = h & mask;
+    while (atoms[i] != NULL) {
+        if (atoms[i]->data.s.hash == h &&
+            str_strcmp(atoms[i]->data.s.str, str) == 0) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static void atom_grow() {
+    object **old = atoms;
+    uint32_t old_sz = atoms_sz;
+    uint32_t i;
+    atoms_sz = atoms_sz ? atoms_sz * 2 : 64;
+    atoms = mem_calloc(atoms_sz, sizeof(object *));
+    for (i = 0; i < old_sz; ++i) {
+        if (old[i] != NULL) {
+            atoms[atom_find(old[i]->data.s.str, old[i]->data.s.hash)] = old[i];
+        }
+    }
+    mem_free(old);
+}
+
+/* takes the entries after the hole back towards their home slots */
+static void atom_remove(object *obj) {
+    uint32_t mask = atoms_sz - 1;
+    uint32_t i = atom_find(obj->data.s.str, obj->data.s.hash);
+    uint32_t j = i;
+    atoms[i] = NULL;
+    while (1) {
+        j = (j + 1) & mask;
+        if (atoms[j] == NULL) {
+            break;
+        }
+        uint32_t home = atoms[j]->data.s.hash & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            atoms[i] = atoms[j];
+            atoms[j] = NULL;
+            i = j;
+        }
+    }
+    atoms_len -= 1;
+    if (atoms_len == 0) {
+        mem_free(atoms);
+        atoms = NULL;
+        atoms_sz = 0;
+    }
+}
+
+/*
+ * the one string object with this value, shared by everyone who interns it.
+ * interned strings compare by pointer against each other. they outlive any
+ * arena, so the table and the strings always come from the heap
+ */
+object *object_str_intern(char_t *str) {
+    uint32_t h = str_hash(str);
+    uint32_t i;
+    object *obj;
+    arena *prev = mem_use_arena(NULL);
+    pthread_mutex_lock(&atoms_lock);
+    if ((atoms_len + 1) * 2 > atoms_sz) {
+        atom_grow();
+    }
+    i = atom_find(str, h);
+    if (atoms[i] != NULL) {
+        obj = atoms[i];
+        atomic_inc(&obj->ref);
+    } else {
+        obj = object_str(str);
+        obj->flags |= OBJECT_INTERNED | OBJECT_HASHED;
+        obj->data.s.hash = h;
+        atoms[i] = obj;
+        atoms_len += 1;
+    }
+    pthread_mutex_unlock(&atoms_lock);
+    mem_use_arena(prev);
+    return obj;
+}
+
+/*
+ * only the last reference needs the lock, so the table never hands out a
+ * string that is being freed
+ */
+static void atom_release(object *obj) {
+#ifdef __GNUC__
+    unsigned int ref = __atomic_load_n(&obj->ref, __ATOMIC_RELAXED);
+    while (ref > 1) {
+        if (__atomic_compare_exchange_n(&obj->ref, &ref, ref - 1, true,
+                __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+    }
+#endif
+    pthread_mutex_lock(&atoms_lock);
+    bool last = atomic_dec(&obj->ref) == 0;
+    if (last) {
+        atom_remove(obj);
+    }
+    pthread_mutex_unlock(&atoms_lock);
+    if (last) {
+        mem_free(obj->data.s.str);
+        mem_slab_free(obj, sizeof(object));
     }
-    
-    return out;
 }
 
 uint32_t object_hash(object *obj) {
     assert(object_hashable(obj));
-    switch (obj->type) {
+    switch (object_type(obj)) {
         case OBJECT_NONE:
             return 0;
         case OBJECT_BOOL:
@@ -168,7 +462,7 @@ uint32_t object_hash(object *obj) {
             }
             return 2;
         case OBJECT_INT:
-            return obj->data.n;
+            return hash_fold(hash_u64(object_int_get(obj)));
         case OBJECT_STR:
             return object_str_hash(obj);
     };
@@ -177,18 +471,24 @@ uint32_t object_hash(object *obj) {
 
 bool object_eq(object *a, object *b) {
     assert(object_hashable(a) && object_hashable(b));
-    if (a->type != b->type) {
+    if (a == b) {
+        return true;
+    }
+    if (object_type(a) != object_type(b)) {
         return false;
     }
-    switch (a->type) {
+    switch (object_type(a)) {
         case OBJECT_NONE:
             return true;
         case OBJECT_BOOL:
             return a == b;
         case OBJECT_INT:
-            return a->data.n == b->data.n;
+            return object_int_get(a) == object_int_get(b);
         case OBJECT_STR:
-            return str_strcmp(a->data.str, b->data.str) == 0;
+            if (a->flags & b->flags & OBJECT_INTERNED) {
+                return false;
+            }
+            return str_strcmp(a->data.s.str, b->data.s.str) == 0;
     };
     return false;
 }
@@ -198,6 +498,9 @@ static bool dec_ref(object *obj) {
 }
 
 void object_free(object *obj) {
+    if (immediate(obj) || obj->flags & (OBJECT_STATIC | OBJECT_ARENA)) {
+        return;
+    }
     switch (obj->type) {
         case OBJECT_NONE:
         case OBJECT_BOOL:
@@ -205,34 +508,85 @@ void object_free(object *obj) {
         case OBJECT_INT:
         case OBJECT_FLOAT:
             if (dec_ref(obj)) {
-                free(obj);
+                mem_slab_free(obj, sizeof(object));
             }
             return;
         case OBJECT_STR:
+            if (obj->flags & OBJECT_INTERNED) {
+                atom_release(obj);
+                return;
+            }
             if (dec_ref(obj)) {
-                free(obj->data.str);
-                free(obj);
+                mem_free(obj->data.s.str);
+                mem_slab_free(obj, sizeof(object));
             }
             return;
         case OBJECT_LIST:
             if (dec_ref(obj)) {
-                while (object_list_length(obj)) {
-                    object_list_remove(obj, 0);
-                }
-                free(obj);
+                list_clear(&obj->data.l);
+                mem_slab_free(obj, sizeof(object));
             }
             return;
         case OBJECT_MAP:
             if (dec_ref(obj)) {
-                map_clear(&obj->data.m);
-                free(obj->data.m.data);
-                free(obj);
+                map_free(&obj->data.m);
+                mem_slab_free(obj, sizeof(object));
             }
             return;
     };
 }
 
+/* a heap copy of an object from an arena, with heap copies of its items */
+static object *object_arena_copy(object *obj) {
+    object *res, *key, *val;
+    switch (obj->type) {
+        case OBJECT_INT:
+            return object_int(obj->data.n);
+        case OBJECT_FLOAT:
+            return object_float(obj->data.f);
+        case OBJECT_STR:
+            return object_str(obj->data.s.str);
+        case OBJECT_LIST: {
+            list_cursor c;
+            res = object_list();
+            list_cursor_init(&c, &obj->data.l, 0, false);
+            while ((val = list_cursor_next(&c)) != NULL) {
+                list_push(&res->data.l, object_detach(val));
+            }
+            return res;
+        }
+        case OBJECT_MAP: {
+            map_cursor c;
+            res = object_map_with_capacity(map_length(&obj->data.m));
+            map_cursor_init(&obj->data.m, &c);
+            while (map_cursor_next(&obj->data.m, &c, &key, &val)) {
+                map_put(&res->data.m, object_detach(key), object_detach(val));
+            }
+            return res;
+        }
+    };
+    return NULL;
+}
+
+/*
+ * outside their arena, arena objects can't change and are never freed, so
+ * they're handed out as they are. object_detach copies one to the heap, to
+ * keep it past arena_reset
+ */
+object *object_detach(object *obj) {
+    if (!immediate(obj) && obj->flags & OBJECT_ARENA && mem_arena() == NULL) {
+        return object_arena_copy(obj);
+    }
+    return object_copy(obj);
+}
+
 object *object_copy(object *obj) {
+    if (immediate(obj) || obj->flags & OBJECT_STATIC) {
+        return obj;
+    }
+    if (obj->flags & OBJECT_ARENA && mem_arena() == NULL) {
+        return obj;
+    }
     switch (obj->type) {
         case OBJECT_BOOL:
         case OBJECT_NONE:
@@ -240,7 +594,11 @@ object *object_copy(object *obj) {
         case OBJECT_INT:
         case OBJECT_FLOAT:
         case OBJECT_STR:
-            ++obj->ref;
+            if (obj->flags & OBJECT_INTERNED) {
+                atomic_inc(&obj->ref);
+            } else {
+                ++obj->ref;
+            }
             return obj;
         case OBJECT_LIST:
             return object_list_copy(obj);
@@ -251,93 +609,282 @@ object *object_copy(object *obj) {
 }
 
 bool object_bool_get(object *obj) {
-    assert(obj->type == OBJECT_BOOL);
+    assert(object_type(obj) == OBJECT_BOOL);
     return obj->data.b;
 }
 
 int64_t object_int_get(object *obj) {
-    assert(obj->type == OBJECT_INT);
+    assert(object_type(obj) == OBJECT_INT);
+#ifdef OBJECT_TAGGED
+    if (immediate(obj)) {
+        return (intptr_t) obj >> 1;
+    }
+#endif
     return obj->data.n;
 }
 
 double object_float_get(object *obj) {
-    assert(obj->type == OBJECT_FLOAT);
+    assert(object_type(obj) == OBJECT_FLOAT);
+#ifdef OBJECT_TAGGED
+    if (immediate(obj)) {
+        return flonum_get(obj);
+    }
+#endif
     return obj->data.f;
 }
 
 char_t *object_str_get(object *obj) {
-    assert(obj->type == OBJECT_STR);
-    return str_strdup(obj->data.str);
+    assert(object_type(obj) == OBJECT_STR);
+    return str_strdup(obj->data.s.str);
+}
+
+/* arena objects can only be changed while their arena is in use */
+#define writable(obj) (!((obj)->flags & OBJECT_ARENA) || mem_arena() != NULL)
+
+/*
+ * an arena value put in a heap container would be gone after arena_reset,
+ * so the container gets a heap copy of it
+ */
+static bool arena_value(object *dst, object *val) {
+    return !(dst->flags & OBJECT_ARENA) && !immediate(val) &&
+        val->flags & OBJECT_ARENA;
+}
+
+/* the value to store in dst, to be given to heap_value_done afterwards */
+static object *heap_value(object *dst, object *val) {
+    if (arena_value(dst, val)) {
+        return object_detach(val);
+    }
+    return val;
+}
+
+static void heap_value_done(object *val, object *orig) {
+    if (val != orig) {
+        object_free(val);
+    }
+}
+
+/*
+ * lists that share nodes can't mix arena and heap nodes, so arena lists are
+ * copied to the heap first
+ */
+static object *heap_list(object *obj) {
+    if (obj->flags & OBJECT_ARENA && mem_arena() == NULL) {
+        return object_detach(obj);
+    }
+    return obj;
+}
+
+static void heap_list_done(object *obj, object *orig) {
+    if (obj != orig) {
+        object_free(obj);
+    }
 }
 
 void object_list_set(object *obj, int32_t i, object *value) {
-    assert(obj->type == OBJECT_LIST);
-    list_set(&obj->data.l, i, value);
+    assert(object_type(obj) == OBJECT_LIST);
+    assert(writable(obj));
+    arena *prev = owner_enter(obj);
+    object *v = heap_value(obj, value);
+    list_set(&obj->data.l, i, v);
+    heap_value_done(v, value);
+    mem_use_arena(prev);
 }
 
 void object_list_insert_at(object *obj, int32_t i, object *value) {
-    assert(obj->type == OBJECT_LIST);
-    list_insert_at(&obj->data.l, i, value);
+    assert(object_type(obj) == OBJECT_LIST);
+    assert(writable(obj));
+    arena *prev = owner_enter(obj);
+    object *v = heap_value(obj, value);
+    list_insert_at(&obj->data.l, i, v);
+    heap_value_done(v, value);
+    mem_use_arena(prev);
 }
 
 void object_list_remove(object *obj, int32_t i) {
-    assert(obj->type == OBJECT_LIST);
+    assert(object_type(obj) == OBJECT_LIST);
+    assert(writable(obj));
+    arena *prev = owner_enter(obj);
     list_remove(&obj->data.l, i);
+    mem_use_arena(prev);
 }
 
 object *object_list_get(object *obj, int32_t i) {
-    assert(obj->type == OBJECT_LIST);
+    assert(object_type(obj) == OBJECT_LIST);
     return list_get(&obj->data.l, i);
 }
 
+void object_list_push(object *obj, object *value) {
+    assert(object_type(obj) == OBJECT_LIST);
+    assert(writable(obj));
+    arena *prev = owner_enter(obj);
+    list_push(&obj->data.l, heap_value(obj, value));
+    mem_use_arena(prev);
+}
+
+object *object_list_from_array(object **items, size_t n) {
+    assert(n <= INT32_MAX);
+    object *obj = object_list();
+    size_t i;
+    for (i = 0; i < n; ++i) {
+        if (arena_value(obj, items[i])) {
+            break;
+        }
+    }
+    if (i == n) {
+        list_push_array(&obj->data.l, items, n);
+        return obj;
+    }
+    for (i = 0; i < n; ++i) {
+        list_push(&obj->data.l, heap_value(obj, items[i]));
+    }
+    return obj;
+}
+
+/*
+ * the results of concat, split and slice are on the heap unless all the lists
+ * they come from are in the arena in use
+ */
+static arena *lists_enter(object *a, object *b) {
+    if (a->flags & b->flags & OBJECT_ARENA) {
+        return mem_arena();
+    }
+    return mem_use_arena(NULL);
+}
+
+object *object_list_concat(object *a, object *b) {
+    assert(object_type(a) == OBJECT_LIST && object_type(b) == OBJECT_LIST);
+    arena *prev = lists_enter(a, b);
+    object *obj = object_list();
+    object *ha = heap_list(a);
+    object *hb = heap_list(b);
+    list_concat(&ha->data.l, &hb->data.l, &obj->data.l);
+    heap_list_done(ha, a);
+    heap_list_done(hb, b);
+    mem_use_arena(prev);
+    return obj;
+}
+
+void object_list_split_at(object *obj, int32_t i, object **a, object **b) {
+    assert(object_type(obj) == OBJECT_LIST);
+    arena *prev = lists_enter(obj, obj);
+    object *h = heap_list(obj);
+    *a = object_list();
+    *b = object_list();
+    list_split(&h->data.l, i, &(*a)->data.l, &(*b)->data.l);
+    heap_list_done(h, obj);
+    mem_use_arena(prev);
+}
+
+object *object_list_slice(object *obj, int32_t start, int32_t end) {
+    assert(object_type(obj) == OBJECT_LIST);
+    arena *prev = lists_enter(obj, obj);
+    object *h = heap_list(obj);
+    object *res = object_list();
+    list_slice(&h->data.l, start, end, &res->data.l);
+    heap_list_done(h, obj);
+    mem_use_arena(prev);
+    return res;
+}
+
+int32_t object_list_get_range
+        (object *obj, int32_t start, int32_t count, object **out, bool borrow) {
+    assert(object_type(obj) == OBJECT_LIST);
+    return list_get_range(&obj->data.l, start, count, out, borrow);
+}
+
 int32_t object_list_length(object *obj) {
     return list_length(&obj->data.l);
 }
 
 void object_map_set(object *obj, object *key, object *val) {
-    assert(obj->type == OBJECT_MAP);
+    assert(object_type(obj) == OBJECT_MAP);
+    assert(writable(obj));
     assert(object_hashable(key));
-    map_set(&obj->data.m, key, val);
+    arena *prev = owner_enter(obj);
+    object *k = heap_value(obj, key);
+    object *v = heap_value(obj, val);
+    map_set(&obj->data.m, k, v);
+    heap_value_done(k, key);
+    heap_value_done(v, val);
+    mem_use_arena(prev);
 }
 
 object *object_map_get(object *obj, object *key) {
-    assert(obj->type == OBJECT_MAP);
+    assert(object_type(obj) == OBJECT_MAP);
     assert(object_hashable(key));
     return map_get(&obj->data.m, key);
 }
 
+void object_map_rem(object *obj, object *key) {
+    assert(object_type(obj) == OBJECT_MAP);
+    assert(writable(obj));
+    assert(object_hashable(key));
+    arena *prev = owner_enter(obj);
+    map_rem(&obj->data.m, key);
+    mem_use_arena(prev);
+}
+
+void object_map_clear(object *obj) {
+    assert(object_type(obj) == OBJECT_MAP);
+    assert(writable(obj));
+    arena *prev = owner_enter(obj);
+    map_clear(&obj->data.m);
+    mem_use_arena(prev);
+}
+
+void object_map_reserve(object *obj, uint32_t n) {
+    assert(object_type(obj) == OBJECT_MAP);
+    assert(writable(obj));
+    arena *prev = owner_enter(obj);
+    map_reserve(&obj->data.m, n);
+    mem_use_arena(prev);
+}
+
+void object_map_shrink_to_fit(object *obj) {
+    assert(object_type(obj) == OBJECT_MAP);
+    assert(writable(obj));
+    arena *prev = owner_enter(obj);
+    map_shrink_to_fit(&obj->data.m);
+    mem_use_arena(prev);
+}
+
 static void object_iterator_map_jmpnext(object_iterator *it) {
-    ++it->pos;
-    while (it->pos < it->dst->data.m.sz) {
-        if (it->dst->data.m.data[it->pos].key != NULL) {
-            break;
-        }
-        ++it->pos;
+    if (!map_cursor_next(&it->dst->data.m, &it->cursor.m, &it->key, &it->val)) {
+        it->key = NULL;
     }
 }
 
 object_iterator *object_iterate(object *obj) {
     assert(object_iterable(obj));
-    object_iterator *it = malloc(sizeof(object_iterator));
+    object_iterator *it = mem_alloc(sizeof(object_iterator));
     it->dst = obj;
-    if (obj->type == OBJECT_MAP) {
-        it->pos = -1;
+    if (object_type(obj) == OBJECT_MAP) {
+        map_cursor_init(&obj->data.m, &it->cursor.m);
         object_iterator_map_jmpnext(it);
     } else {
-        it->pos = 0;
+        list_cursor_init(&it->cursor.l, &obj->data.l, 0, false);
     }
     return it;
 }
 
+object_iterator *object_list_iterate(object *obj, int32_t i, bool reverse) {
+    assert(object_type(obj) == OBJECT_LIST);
+    object_iterator *it = mem_alloc(sizeof(object_iterator));
+    it->dst = obj;
+    list_cursor_init(&it->cursor.l, &obj->data.l, i, reverse);
+    return it;
+}
+
 void object_iterator_free(object_iterator *it) {
-    free(it);
+    mem_free(it);
 }
 
 bool object_iterator_hasnext(object_iterator *it) {
-    if (it->dst->type == OBJECT_MAP) {
-        return it->pos < it->dst->data.m.sz - 1;
-    } else if (it->dst->type == OBJECT_LIST) {
-        return (int64_t) it->pos < object_list_length(it->dst);
+    if (object_type(it->dst) == OBJECT_MAP) {
+        return it->key != NULL;
+    } else if (object_type(it->dst) == OBJECT_LIST) {
+        return it->cursor.l.remaining > 0;
     }
     return false;
 }
@@ -345,57 +892,74 @@ bool object_iterator_hasnext(object_iterator *it) {
 object *object_iterator_getnext(object_iterator *it) {
     assert(object_iterator_hasnext(it));
     
-    if (it->dst->type == OBJECT_MAP) {
+    if (object_type(it->dst) == OBJECT_MAP) {
         object *ret = object_list();
-        record *rec = &it->dst->data.m.data[it->pos];
-        object_list_set(ret, 0, rec->key);
-        object_list_set(ret, 1, rec->val);
+        object_list_set(ret, 0, it->key);
+        object_list_set(ret, 1, it->val);
         object_iterator_map_jmpnext(it);
         return ret;
     }
     
-    if (it->dst->type == OBJECT_LIST) {
-        return object_list_get(it->dst, (it->pos)++);
+    if (object_type(it->dst) == OBJECT_LIST) {
+        return object_copy(list_cursor_next(&it->cursor.l));
     }
     return NULL;
 }
 
+/*
+ * the next key and value of a map iterator, without copying them. they're
+ * only valid while the map is unchanged. false at the end
+ */
+bool object_iterator_next_pair(object_iterator *it, object **key, object **val) {
+    assert(object_type(it->dst) == OBJECT_MAP);
+    if (it->key == NULL) {
+        return false;
+    }
+    *key = it->key;
+    *val = it->val;
+    object_iterator_map_jmpnext(it);
+    return true;
+}
+
 static size_t object_join_sz(object *obj) {
-    assert(obj->type == OBJECT_LIST || obj->type == OBJECT_STR);
-    if (obj->type == OBJECT_STR) {
-        return str_strlen(obj->data.str);
+    assert(object_type(obj) == OBJECT_LIST || object_type(obj) == OBJECT_STR);
+    if (object_type(obj) == OBJECT_STR) {
+        return str_strlen(obj->data.s.str);
     } else {
         size_t len = 0;
-        int32_t i;
-        for (i = 0; i < object_list_length(obj); ++i) {
-            object *item = object_list_get(obj, i);
+        list_cursor c;
+        object *item;
+        list_cursor_init(&c, &obj->data.l, 0, false);
+        while ((item = list_cursor_next(&c)) != NULL) {
             len += object_join_sz(item);
-            object_free(item);
         }
         return len;
     }
 }
 
-static void object_join_write(object *obj, char_t *str) {
-    assert(obj->type == OBJECT_LIST || obj->type == OBJECT_STR);
-    if (obj->type == OBJECT_STR) {
-        str_strcpy(str, obj->data.str);
+static size_t object_join_write(object *obj, char_t *str) {
+    assert(object_type(obj) == OBJECT_LIST || object_type(obj) == OBJECT_STR);
+    if (object_type(obj) == OBJECT_STR) {
+        str_strcpy(str, obj->data.s.str);
+        return str_strlen(obj->data.s.str);
     } else {
-        int32_t i;
-        for (i = 0; i < object_list_length(obj); ++i) {
-            object *item = object_list_get(obj, i);
-            object_join_write(item, str);
-            object_free(item);
-            str += object_join_sz(item);
+        size_t len = 0;
+        list_cursor c;
+        object *item;
+        list_cursor_init(&c, &obj->data.l, 0, false);
+        while ((item = list_cursor_next(&c)) != NULL) {
+            len += object_join_write(item, str + len);
         }
+        return len;
     }
 }
 
 char_t *object_join(object *obj) {
-    assert(obj->type == OBJECT_LIST || obj->type == OBJECT_STR);
+    assert(object_type(obj) == OBJECT_LIST || object_type(obj) == OBJECT_STR);
     size_t len = object_join_sz(obj);
-    char_t *res = malloc(sizeof(char_t) * (len + 1));
+    char_t *res = mem_alloc(sizeof(char_t) * (len + 1));
     object_join_write(obj, res);
+    res[len] = 0;
     return res;
 }
 
@@ -456,7 +1020,7 @@ static uint32_t str_to_json_len(object *obj) {
             len += str_encoding_length(c);
         }
     }
-    free(str);
+    mem_free(str);
     return len;
 }
 
@@ -489,7 +1053,7 @@ static uint32_t str_to_json_write(char_t *str, object *obj) {
         }
     }
     str_append(str, &j, '"');
-    free(val);
+    mem_free(val);
     return j;
 }
 
@@ -502,32 +1066,29 @@ static uint32_t float_to_json_len(double val) {
 
 static uint32_t float_to_json_write(char_t *str, double val) {
     assert(!isnan(val) && !isinf(val));
-    char *out;
-    int sz = asprintf(&out, "%.17g", val);
+    /* the longest is like -1.2345678901234567e-308 */
+    char out[32];
+    int sz = snprintf(out, sizeof(out), "%.17g", val);
+    assert(sz > 0 && (size_t) sz < sizeof(out));
     str_convert(out, str, sz + 1);
-    free(out);
     return sz;
 }
 
 static uint32_t list_to_json_len(object *obj, bool pretty) {
     assert(pretty == false && "pretty printing hasn't been written");
     uint32_t len = 2; /* opening and closing brackets */
-    object_iterator *it = object_iterate(obj);
+    list_cursor c;
     object *item;
     
-    while (object_iterator_hasnext(it)) {
-        item = object_iterator_getnext(it);
-        
+    list_cursor_init(&c, &obj->data.l, 0, false);
+    while ((item = list_cursor_next(&c)) != NULL) {
         len += object_to_json_len(item, pretty);
         
-        if (object_iterator_hasnext(it)) {
+        if (c.remaining > 0) {
             len += 1; /* comma */
         }
-        
-        object_free(item);
     }
     
-    object_iterator_free(it);
     return len;
 }
 
@@ -535,22 +1096,18 @@ static uint32_t list_to_json_write(char_t *str, object *obj, bool pretty) {
     assert(pretty == false && "pretty printing hasn't been written");
     uint32_t i = 0;
     str_append(str, &i, '[');
-    object_iterator *it = object_iterate(obj);
+    list_cursor c;
     object *item;
     
-    while (object_iterator_hasnext(it)) {
-        item = object_iterator_getnext(it);
-        
+    list_cursor_init(&c, &obj->data.l, 0, false);
+    while ((item = list_cursor_next(&c)) != NULL) {
         i += object_to_json_write(str + i, item, pretty);
         
-        if (object_iterator_hasnext(it)) {
+        if (c.remaining > 0) {
             str_append(str, &i, ',');
         }
-        
-        object_free(item);
     }
     
-    object_iterator_free(it);
     str_append(str, &i, ']');
     return i;
 }
@@ -560,14 +1117,9 @@ static uint32_t map_to_json_len(object *obj, bool pretty) {
     uint32_t len = 2;
     
     object_iterator *it = object_iterate(obj);
-    object *item;
+    object *key, *val;
     
-    while (object_iterator_hasnext(it)) {
-        item = object_iterator_getnext(it);
-        
-        object *key = object_list_get(item, 0);
-        object *val = object_list_get(item, 1);
-        
+    while (object_iterator_next_pair(it, &key, &val)) {
         len += object_to_json_len(key, pretty);
         len += 1;
         len += object_to_json_len(val, pretty);
@@ -575,10 +1127,6 @@ static uint32_t map_to_json_len(object *obj, bool pretty) {
         if (object_iterator_hasnext(it)) {
             len += 1;
         }
-        
-        object_free(key);
-        object_free(val);
-        object_free(item);
     }
     
     object_iterator_free(it);
@@ -592,14 +1140,9 @@ static uint32_t map_to_json_write(char_t *str, object *obj, bool pretty) {
     str_append(str, &i, '{');
     
     object_iterator *it = object_iterate(obj);
-    object *item;
+    object *key, *val;
     
-    while (object_iterator_hasnext(it)) {
-        item = object_iterator_getnext(it);
-        
-        object *key = object_list_get(item, 0);
-        object *val = object_list_get(item, 1);
-        
+    while (object_iterator_next_pair(it, &key, &val)) {
         i += object_to_json_write(str + i, key, pretty);
         str_append(str, &i, ':');
         i += object_to_json_write(str + i, val, pretty);
@@ -607,10 +1150,6 @@ static uint32_t map_to_json_write(char_t *str, object *obj, bool pretty) {
         if (object_iterator_hasnext(it)) {
             str_append(str, &i, ',');
         }
-        
-        object_free(key);
-        object_free(val);
-        object_free(item);
     }
     
     object_iterator_free(it);
@@ -619,7 +1158,7 @@ static uint32_t map_to_json_write(char_t *str, object *obj, bool pretty) {
 }
 
 static uint32_t object_to_json_len(object *obj, bool pretty) {
-    switch (obj->type) {
+    switch (object_type(obj)) {
         case OBJECT_NONE:
             return 4;
         case OBJECT_BOOL:
@@ -646,7 +1185,7 @@ static uint32_t object_to_json_write(char_t *str, object *obj, bool pr) {
     STR_INIT(none_string, "null", 4);
     STR_INIT(true_string, "true", 4);
     STR_INIT(false_string, "false", 5);
-    switch (obj->type) {
+    switch (object_type(obj)) {
         case OBJECT_NONE:
             str_strcpy(str, none_string);
             return 4;
@@ -674,7 +1213,7 @@ static uint32_t object_to_json_write(char_t *str, object *obj, bool pr) {
 
 char_t *object_to_json(object *obj, bool pretty) {
     uint32_t n = object_to_json_len(obj, pretty);
-    char_t *res = malloc(sizeof(char_t) * (n + 1));
+    char_t *res = mem_alloc(sizeof(char_t) * (n + 1));
     object_to_json_write(res, obj, pretty);
     res[n] = '\0';
     return res;
@@ -693,9 +1232,11 @@ typedef struct {
     uint32_t i;
 } parse_result;
 
-parse_result object_from_json_int(const char_t *str, uint32_t);
+parse_result object_from_json_int
+        (const char_t *str, uint32_t, int, map_shape *);
 
-static parse_result parse_string(uint32_t i, uint32_t sz, const char_t *str) {
+static parse_result parse_string
+        (uint32_t i, uint32_t sz, const char_t *str, bool intern) {
     uint32_t n = 0, m = 0;
     uint32_t start = i;
     uint32_t c;
@@ -784,86 +1325,149 @@ static parse_result parse_string(uint32_t i, uint32_t sz, const char_t *str) {
             }
         }
         if (stage == 1) {
-            string = malloc(sizeof(char_t) * (n + 1));
+            string = mem_alloc(sizeof(char_t) * (n + 1));
         } else {
             string[m] = 0;
         }
     }
-    parse_result res = {object_str(string), i};
-    free(string);
+    object *obj;
+    if (intern) {
+        obj = object_str_intern(string);
+        mem_free(string);
+    } else {
+        obj = object_str_owned(string);
+    }
+    parse_result res = {obj, i};
     return res;
 }
 
-static parse_result parse_map(uint32_t i, uint32_t sz, const char_t *str) {
-    object *m = object_map();
-    if (i >= sz) {
+/* a map that stores vals under the keys of shape, taking both references */
+static object *object_map_shaped(map_shape *shape, object **vals) {
+    object *obj = object_new(OBJECT_MAP);
+    map_init_shaped(&obj->data.m, shape, vals);
+    return obj;
+}
+
+/* moves the first n values collected for shape into a normal map */
+static object *unshape_values(map_shape *shape, object **vals, uint32_t n) {
+    object *m = object_map_with_capacity(n);
+    uint32_t j;
+    for (j = 0; j < n; ++j) {
+        map_put(&m->data.m, object_copy(map_shape_key(shape, j)), vals[j]);
+    }
+    return m;
+}
+
+static parse_result parse_map_fail
+        (object *m, object **vals, uint32_t n, uint32_t i) {
+    uint32_t j;
+    for (j = 0; j < n; ++j) {
+        object_free(vals[j]);
+    }
+    mem_free(vals);
+    if (m != NULL) {
         object_free(m);
-        parse_result res = {NULL, i};
-        return res;
     }
-    uint32_t c = get_after_ws(str, &i, sz);
-    if (c == '}') {
-        parse_result res = {m, i};
-        return res;
+    parse_result res = {NULL, i};
+    return res;
+}
+
+/*
+ * while the keys match the shape, in order, the values are collected for a
+ * shaped map. the first key that doesn't match moves them into a normal map
+ */
+static parse_result parse_map(uint32_t i, uint32_t sz, const char_t *str,
+                              int flags, map_shape *shape) {
+    object *m = NULL;
+    object **vals = NULL;
+    uint32_t n = 0;
+    if (shape != NULL) {
+        vals = mem_alloc(sizeof(object *) * map_shape_length(shape));
+    } else {
+        m = object_map();
     }
-    while (1) {
+    if (i >= sz) {
+        return parse_map_fail(m, vals, n, i);
+    }
+    uint32_t c = get_after_ws(str, &i, sz);
+    while (c != '}') {
         if (c != '"') {
-            object_free(m);
-            parse_result res = {NULL, i};
-            return res;
+            return parse_map_fail(m, vals, n, i);
         }
-        parse_result key = parse_string(i, sz, str);
+        parse_result key =
+            parse_string(i, sz, str, flags & OBJECT_JSON_INTERN_KEYS);
         i = key.i;
         if (key.obj == NULL || i >= sz) {
-            object_free(m);
-            parse_result res = {NULL, i};
-            return res;
+            return parse_map_fail(m, vals, n, i);
         }
         c = get_after_ws(str, &i, sz);
         if (c != ':') {
-            object_free(m);
             object_free(key.obj);
-            parse_result res = {NULL, i};
-            return res;
+            return parse_map_fail(m, vals, n, i);
         }
-        parse_result val = object_from_json_int(str + i, sz - 1);
+        parse_result val = object_from_json_int(str + i, sz - 1, flags, NULL);
         i += val.i;
         if (val.obj == NULL) {
-            object_free(m);
             object_free(key.obj);
-            parse_result res = {NULL, i};
-            return res;
+            return parse_map_fail(m, vals, n, i);
+        }
+        if (m == NULL && n < map_shape_length(shape) &&
+            object_eq(key.obj, map_shape_key(shape, n))) {
+            vals[n++] = val.obj;
+            object_free(key.obj);
+        } else {
+            if (m == NULL) {
+                m = unshape_values(shape, vals, n);
+                n = 0;
+            }
+            map_put(&m->data.m, key.obj, val.obj);
         }
-        object_map_set(m, key.obj, val.obj);
-        object_free(key.obj);
-        object_free(val.obj);
         if (i >= sz) {
-            object_free(m);
-            parse_result res = {NULL, i};
-            return res;
+            return parse_map_fail(m, vals, n, i);
         }
         c = get_after_ws(str, &i, sz);
         if (c == '}') {
             break;
         }
         if (c != ',' || i >= sz) {
-            object_free(m);
-            parse_result res = {NULL, i};
-            return res;
+            return parse_map_fail(m, vals, n, i);
         }
         c = get_after_ws(str, &i, sz);
     }
+    if (m == NULL && n == map_shape_length(shape)) {
+        m = object_map_shaped(map_shape_copy(shape), vals);
+    } else {
+        if (m == NULL) {
+            m = unshape_values(shape, vals, n);
+        }
+        mem_free(vals);
+    }
     parse_result res = {m, i};
     return res;
 }
 
-static parse_result parse_list(uint32_t i, uint32_t sz, const char_t *str) {
+static parse_result parse_list_fail
+        (object *lst, map_shape *shape, uint32_t i) {
+    if (shape != NULL) {
+        map_shape_release(shape);
+    }
+    object_free(lst);
+    parse_result res = {NULL, i};
+    return res;
+}
+
+/*
+ * when the first item is a map, its keys become a shape that the following
+ * maps share if they have the same keys in the same order
+ */
+static parse_result parse_list
+        (uint32_t i, uint32_t sz, const char_t *str, int flags) {
     object *lst = object_list();
+    object *first = NULL;
+    map_shape *shape = NULL;
     uint32_t next = i;
     if (i >= sz) {
-        object_free(lst);
-        parse_result res = {NULL, i};
-        return res;
+        return parse_list_fail(lst, shape, i);
     }
     uint32_t c = get_after_ws(str, &next, sz);
     if (c == ']') {
@@ -871,20 +1475,26 @@ static parse_result parse_list(uint32_t i, uint32_t sz, const char_t *str) {
         return res;
     }
     while (1) {
-        parse_result item = object_from_json_int(str + i, sz - i);
+        if (first != NULL && object_type(first) == OBJECT_MAP &&
+            shape == NULL && mem_arena() == NULL) {
+            shape = map_shape_new(&first->data.m);
+            if (shape != NULL) {
+                map_use_shape(&first->data.m, shape);
+            }
+        }
+        parse_result item =
+            object_from_json_int(str + i, sz - i, flags, shape);
         i += item.i;
         if (item.obj == NULL) {
-            object_free(lst);
-            parse_result res = {NULL, i};
-            return res;
+            return parse_list_fail(lst, shape, i);
+        }
+        object_list_push(lst, item.obj);
+        if (first == NULL) {
+            first = item.obj;
         }
-        object_list_set(lst, object_list_length(lst), item.obj);
-        object_free(item.obj);
         
         if (i >= sz) {
-            object_free(lst);
-            parse_result res = {NULL, i};
-            return res;
+            return parse_list_fail(lst, shape, i);
         }
         c = get_after_ws(str, &i, sz);
         
@@ -892,11 +1502,12 @@ static parse_result parse_list(uint32_t i, uint32_t sz, const char_t *str) {
             break;
         }
         if (c != ',') {
-            object_free(lst);
-            parse_result res = {NULL, i};
-            return res;
+            return parse_list_fail(lst, shape, i);
         }
     }
+    if (shape != NULL) {
+        map_shape_release(shape);
+    }
     parse_result res = {lst, i};
     return res;
 }
@@ -1012,7 +1623,8 @@ static parse_result parse_num
     return res;
 }
 
-parse_result object_from_json_int(const char_t *str, uint32_t sz) {
+parse_result object_from_json_int
+        (const char_t *str, uint32_t sz, int flags, map_shape *shape) {
     uint32_t i=0;
     if (i >= sz) {
         parse_result res = {NULL, i};
@@ -1020,9 +1632,9 @@ parse_result object_from_json_int(const char_t *str, uint32_t sz) {
     }
     uint32_t c = get_after_ws(str, &i, sz);
     if (c == '{') {
-        return parse_map(i, sz, str);
+        return parse_map(i, sz, str, flags, shape);
     } else if (c == '[') {
-        return parse_list(i, sz, str);
+        return parse_list(i, sz, str, flags);
     } else if (c == 'n') {
         STR_INIT(null, "ull", 3);
         if (str_memcmp(str + i, null, 3) == 0) {
@@ -1048,7 +1660,7 @@ parse_result object_from_json_int(const char_t *str, uint32_t sz) {
         parse_result res = {NULL, i};
         return res;
     } else if (c == '"') {
-        return parse_string(i, sz, str);
+        return parse_string(i, sz, str, false);
     } else if (c == '-' || (c >= '0' && c <= '9')) {
         return parse_num(c, i, sz, str);
     } else {
@@ -1058,6 +1670,26 @@ parse_result object_from_json_int(const char_t *str, uint32_t sz) {
 }
 
 object *object_from_json(const char_t *str) {
-    parse_result res = object_from_json_int(str, str_strlen(str));
+    return object_from_json_flags(str, 0);
+}
+
+object *object_from_json_flags(const char_t *str, int flags) {
+    parse_result res =
+        object_from_json_int(str, str_strlen(str), flags, NULL);
+    return res.obj;
+}
+
+/*
+ * parses a document whose objects, strings and containers all live in the
+ * arena, so it's freed by arena_reset. the document can be read but not
+ * changed. what's read from it belongs to the arena too, so values kept past
+ * arena_reset or put in other containers need object_detach. shapes and
+ * interned keys are shared beyond a single document, so the parser doesn't
+ * use them
+ */
+object *object_from_json_arena(arena *a, const char_t *str) {
+    arena *prev = mem_use_arena(a);
+    parse_result res = object_from_json_int(str, str_strlen(str), 0, NULL);
+    mem_use_arena(prev);
     return res.obj;
 }
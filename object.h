@@ -20,9 +20,11 @@
 #ifndef OBJECT_H
 #define OBJECT_H
 
+#include "stddef.h"
 #include "stdint.h"
 #include "stdbool.h"
 #include "string_type.h"
+#include "mem.h"
 
 struct object;
 typedef struct object object;
@@ -39,8 +41,11 @@ typedef struct object_iterator object_iterator;
 #define OBJECT_BOOL 7
 
 object *object_map();
+object *object_map_with_capacity(uint32_t);
+object *object_map_persistent();
 object *object_list();
 object *object_str(char_t *);
+object *object_str_intern(char_t *);
 object *object_int(int64_t);
 object *object_float(double);
 object *object_none();
@@ -48,6 +53,7 @@ object *object_bool(bool);
 
 int object_type(object *);
 object *object_copy(object *);
+object *object_detach(object *);
 void object_free(object *);
 bool object_hashable(object *);
 bool object_iterable(object *);
@@ -58,12 +64,21 @@ void object_map_set(object *, object *, object *);
 void object_map_rem(object *, object *);
 object *object_map_get(object *, object *);
 void object_map_clear(object *);
+void object_map_reserve(object *, uint32_t);
+void object_map_shrink_to_fit(object *);
 
 void object_list_set(object *, int32_t, object *);
 void object_list_insert_at(object *, int32_t, object *);
 void object_list_remove(object *, int32_t);
 object *object_list_get(object *, int32_t);
+int32_t object_list_get_range(object *, int32_t, int32_t, object **, bool);
 int32_t object_list_length(object *);
+object *object_list_concat(object *, object *);
+void object_list_split_at(object *, int32_t, object **, object **);
+object *object_list_slice(object *, int32_t, int32_t);
+/* these take over the caller's references to the items */
+void object_list_push(object *, object *);
+object *object_list_from_array(object **, size_t);
 
 char_t *object_str_get(object *);
 int64_t object_int_get(object *);
@@ -71,13 +86,25 @@ double object_float_get(object *);
 bool object_bool_get(object *);
 
 object_iterator *object_iterate(object *);
+object_iterator *object_list_iterate(object *, int32_t, bool);
 bool object_iterator_hasnext(object_iterator *);
 object *object_iterator_getnext(object_iterator *);
+bool object_iterator_next_pair(object_iterator *, object **, object **);
 void object_iterator_free(object_iterator *);
 
 char_t *object_join(object *);
 
 char_t *object_to_json(object *, bool);
+/*
+ * object_from_json_flags options. interned keys are shared with every other
+ * document and thread interning the same strings. that is safe, but only
+ * interned strings are: other objects still mustn't be used by two threads
+ * at once
+ */
+#define OBJECT_JSON_INTERN_KEYS 1
+
 object *object_from_json(const char_t *);
+object *object_from_json_flags(const char_t *, int);
+object *object_from_json_arena(arena *, const char_t *);
 
 #endif
@@ -22,6 +22,8 @@
 #include "assert.h"
 #include "stdlib.h"
 
+#include "mem.h"
+
 void str_convert(const char *in, char_t *out, uint32_t out_sz) {
     uint32_t i = 0;
     while (1) {
@@ -38,7 +40,7 @@ void str_convert(const char *in, char_t *out, uint32_t out_sz) {
 #ifdef BUTTERFLY_USE_ICU
 char_t *str_strdup(const char_t *in) {
     uint32_t len = u_strlen(in) + 1;
-    UChar *result = malloc(sizeof(UChar) * len);
+    UChar *result = mem_alloc(sizeof(UChar) * len);
     u_memcpy(result, in, len);
     return result;
 }
@@ -76,7 +78,10 @@ int str_memcmp(const char_t *dst, const char_t *src, uint32_t sz) {
 
 #ifdef BUTTERFLY_USE_ASCII
 char_t *str_strdup(const char_t *str) {
-    return strdup(str);
+    size_t len = strlen(str) + 1;
+    char_t *res = mem_alloc(len);
+    memcpy(res, str, len);
+    return res;
 }
 
 int str_strcmp(const char_t *a, const char_t *b) {
@@ -88,6 +88,23 @@ START_TEST (iterate_map_2) {
     fail_unless(!object_iterator_hasnext(it), NULL);
 } END_TEST
 
+START_TEST (iterate_map_3) {
+    STR_INIT(map_string, "{\"a\": 1, \"b\": [2]}", 18);
+    object *map = object_from_json(map_string);
+    object *key, *val;
+    
+    object_iterator *it = object_iterate(map);
+    fail_unless(object_iterator_next_pair(it, &key, &val), NULL);
+    fail_unless(object_type(key) == OBJECT_STR, NULL);
+    fail_unless(object_int_get(val) == 1, NULL);
+    fail_unless(object_iterator_next_pair(it, &key, &val), NULL);
+    fail_unless(object_list_length(val) == 1, NULL);
+    fail_unless(!object_iterator_next_pair(it, &key, &val), NULL);
+    
+    object_iterator_free(it);
+    object_free(map);
+} END_TEST
+
 START_TEST (iterate_list_1) {
     STR_INIT(list_string, "[0, 1]", 6);
     object *lst = object_from_json(list_string);
@@ -154,13 +171,55 @@ START_TEST (iterate_list_4) {
     fail_unless(!object_iterator_hasnext(it), NULL);
 } END_TEST
 
+START_TEST (iterate_list_5) {
+    object *lst = object_list();
+    object *item;
+    int32_t i;
+    
+    for (i = 0; i < 1000; ++i) {
+        item = object_int(i);
+        object_list_insert_at(lst, i / 2, item);
+        object_free(item);
+    }
+    
+    object_iterator *it = object_list_iterate(lst, 999, true);
+    int32_t prev = 1000;
+    for (i = 0; i < 1000; ++i) {
+        fail_unless(object_iterator_hasnext(it), NULL);
+        item = object_iterator_getnext(it);
+        object *expected = object_list_get(lst, 999 - i);
+        fail_unless(object_eq(item, expected), NULL);
+        fail_unless(object_int_get(item) != prev, NULL);
+        prev = object_int_get(item);
+        object_free(expected);
+        object_free(item);
+    }
+    fail_unless(!object_iterator_hasnext(it), NULL);
+    object_iterator_free(it);
+    
+    it = object_list_iterate(lst, 500, false);
+    for (i = 500; i < 1000; ++i) {
+        item = object_iterator_getnext(it);
+        object *expected = object_list_get(lst, i);
+        fail_unless(object_eq(item, expected), NULL);
+        object_free(expected);
+        object_free(item);
+    }
+    fail_unless(!object_iterator_hasnext(it), NULL);
+    object_iterator_free(it);
+    
+    object_free(lst);
+} END_TEST
+
 TCase *iterator_test_case() {
     TCase *tc = tcase_create("iteration");
     tcase_add_test(tc, iterate_map_1);
     tcase_add_test(tc, iterate_map_2);
+    tcase_add_test(tc, iterate_map_3);
     tcase_add_test(tc, iterate_list_1);
     tcase_add_test(tc, iterate_list_2);
     tcase_add_test(tc, iterate_list_3);
     tcase_add_test(tc, iterate_list_4);
+    tcase_add_test(tc, iterate_list_5);
     return tc;
 }
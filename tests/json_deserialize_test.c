@@ -257,6 +257,229 @@ START_TEST (test_map_3) {
     fail_unless(obj != NULL, NULL);
 } END_TEST
 
+/* the first key of a parsed map, borrowed from it */
+static object *first_key(object *map) {
+    object *key, *val;
+    object_iterator *it = object_iterate(map);
+    fail_unless(object_iterator_next_pair(it, &key, &val), NULL);
+    object_iterator_free(it);
+    return key;
+}
+
+START_TEST (test_map_4) {
+    STR_INIT(first_str, "{\"id\":1}", 8);
+    STR_INIT(second_str, "{\"id\":2}", 8);
+    STR_INIT(key_str, "id", 2);
+    object *key = object_str_intern(key_str);
+    
+    /* interned keys are one object across documents */
+    object *first = object_from_json_flags(first_str, OBJECT_JSON_INTERN_KEYS);
+    object *second = object_from_json_flags(second_str,
+            OBJECT_JSON_INTERN_KEYS);
+    fail_unless(first != NULL && second != NULL, NULL);
+    fail_unless(first_key(first) == key, NULL);
+    fail_unless(first_key(second) == key, NULL);
+    object *val = object_map_get(second, key);
+    fail_unless(object_int_get(val) == 2, NULL);
+    object_free(val);
+    object_free(first);
+    object_free(second);
+    
+    /* without the flag every document has its own */
+    first = object_from_json(first_str);
+    second = object_from_json(second_str);
+    fail_unless(first_key(first) != key, NULL);
+    fail_unless(first_key(first) != first_key(second), NULL);
+    fail_unless(object_eq(first_key(first), key), NULL);
+    object_free(first);
+    object_free(second);
+    object_free(key);
+} END_TEST
+
+START_TEST (test_map_5) {
+    STR_INIT(list_str, "[{\"a\":1,\"b\":2},{\"a\":3,\"b\":4},{\"b\":5}]", 37);
+    object *obj = object_from_json(list_str);
+    fail_unless(obj != NULL, NULL);
+    STR_INIT(a_str, "a", 1);
+    STR_INIT(b_str, "b", 1);
+    object *a = object_str(a_str);
+    object *b = object_str(b_str);
+    object *second = object_list_get(obj, 1);
+    object *val = object_map_get(second, b);
+    fail_unless(object_int_get(val) == 4, NULL);
+    object_free(val);
+    
+    /* a new key gives the map its own layout */
+    object_map_set(second, b, a);
+    object_map_rem(second, a);
+    val = object_map_get(second, b);
+    fail_unless(object_eq(val, a), NULL);
+    object_free(val);
+    fail_unless(object_map_get(second, a) == NULL, NULL);
+    
+    object *third = object_list_get(obj, 2);
+    fail_unless(object_map_get(third, a) == NULL, NULL);
+    val = object_map_get(third, b);
+    fail_unless(object_int_get(val) == 5, NULL);
+    object_free(val);
+    
+    object_free(third);
+    object_free(second);
+    object_free(a);
+    object_free(b);
+    object_free(obj);
+} END_TEST
+
+START_TEST (test_map_6) {
+    STR_INIT(list_str, "[{\"a\":1,\"b\":2},{\"a\":3,\"b\":4}]", 29);
+    STR_INIT(a_str, "a", 1);
+    STR_INIT(b_str, "b", 1);
+    object *obj = object_from_json(list_str);
+    object *second = object_list_get(obj, 1);
+    
+    /* a new key at the address of one looked up before isn't mistaken for it */
+    arena *a = arena_new();
+    arena *prev = mem_use_arena(a);
+    object *key = object_str(a_str);
+    object *val = object_map_get(second, key);
+    fail_unless(object_int_get(val) == 3, NULL);
+    arena_reset(a);
+    key = object_str(b_str);
+    val = object_map_get(second, key);
+    fail_unless(object_int_get(val) == 4, NULL);
+    mem_use_arena(prev);
+    arena_free(a);
+    
+    object_free(second);
+    object_free(obj);
+} END_TEST
+
+static size_t allocations;
+static int64_t live;
+
+static void *counting_malloc(void *ctx, size_t n) {
+    fail_unless(ctx == &allocations, NULL);
+    allocations += 1;
+    live += 1;
+    return malloc(n);
+}
+
+static void *counting_realloc(void *ctx, void *p, size_t n) {
+    fail_unless(ctx == &allocations, NULL);
+    allocations += 1;
+    return realloc(p, n);
+}
+
+static void counting_free(void *ctx, void *p) {
+    fail_unless(ctx == &allocations, NULL);
+    live -= 1;
+    free(p);
+}
+
+START_TEST (test_allocator) {
+    allocations = 0;
+    live = 0;
+    butterfly_set_allocator(counting_malloc, counting_realloc, counting_free,
+            &allocations);
+    STR_INIT(str, "{\"a\":[1,2.5,\"x\"],\"b\":{\"c\":null}}", 32);
+    object *obj = object_from_json(str);
+    fail_unless(obj != NULL, NULL);
+    char_t *out = object_to_json(obj, false);
+    fail_unless(str_strcmp(out, str) == 0, NULL);
+    mem_free(out);
+    object_free(obj);
+    fail_unless(allocations > 0, NULL);
+#ifndef BUTTERFLY_SLAB
+    /* the slabs keep their pages */
+    fail_unless(live == 0, NULL);
+#endif
+    butterfly_set_allocator(NULL, NULL, NULL, NULL);
+} END_TEST
+
+START_TEST (test_arena) {
+    STR_INIT(str, "{\"a\":[1,2,{\"b\":\"x\"}],\"c\":3}", 27);
+    arena *a = arena_new();
+    object *obj = object_from_json_arena(a, str);
+    fail_unless(obj != NULL, NULL);
+    STR_INIT(a_str, "a", 1);
+    STR_INIT(b_str, "b", 1);
+    STR_INIT(c_str, "c", 1);
+    STR_INIT(x_str, "x", 1);
+    object *a_key = object_str(a_str);
+    object *b_key = object_str(b_str);
+    object *c_key = object_str(c_str);
+    object *x = object_str(x_str);
+    object *val = object_map_get(obj, c_key);
+    fail_unless(object_int_get(val) == 3, NULL);
+    object_free(val);
+    
+    /* reading nested containers hands out the arena's objects */
+    allocations = 0;
+    butterfly_set_allocator(counting_malloc, counting_realloc, counting_free,
+            &allocations);
+    object *list = object_map_get(obj, a_key);
+    object *inner = object_list_get(list, 2);
+    val = object_map_get(inner, b_key);
+    fail_unless(object_eq(val, x), NULL);
+    object_free(val);
+    object_free(inner);
+    butterfly_set_allocator(NULL, NULL, NULL, NULL);
+    fail_unless(allocations == 0, NULL);
+    
+    /* detached copies survive a reset */
+    object *copy = object_detach(list);
+    object_free(list);
+    arena_reset(a);
+    fail_unless(object_list_length(copy) == 3, NULL);
+    object *first = object_list_get(copy, 0);
+    fail_unless(object_int_get(first) == 1, NULL);
+    object_free(first);
+    
+    object_free(copy);
+    object_free(a_key);
+    object_free(b_key);
+    object_free(c_key);
+    object_free(x);
+    arena_free(a);
+} END_TEST
+
+START_TEST (test_arena_heap) {
+    STR_INIT(str, "[\"x\",[1,2]]", 11);
+    STR_INIT(x_str, "x", 1);
+    object *list = object_list();
+    object *x = object_str(x_str);
+    object_list_push(list, object_copy(x));
+    arena *a = arena_new();
+    
+    /* heap containers keep their insides and values on the heap */
+    arena *prev = mem_use_arena(a);
+    object *doc = object_from_json(str);
+    object *copy = object_copy(list);
+    object_list_push(list, object_str(x_str));
+    object *first = object_list_get(doc, 0);
+    object_list_set(list, 0, first);
+    object_free(first);
+    mem_use_arena(prev);
+    object *second = object_list_get(doc, 1);
+    object_list_push(copy, second);
+    arena_free(a);
+    
+    fail_unless(object_list_length(list) == 2, NULL);
+    object *val = object_list_get(list, 0);
+    fail_unless(object_eq(val, x), NULL);
+    object_free(val);
+    val = object_list_get(list, 1);
+    fail_unless(object_eq(val, x), NULL);
+    object_free(val);
+    fail_unless(object_list_length(copy) == 2, NULL);
+    val = object_list_get(copy, 1);
+    fail_unless(object_list_length(val) == 2, NULL);
+    object_free(val);
+    object_free(copy);
+    object_free(list);
+    object_free(x);
+} END_TEST
+
 TCase *json_deserialize_test_case() {
     TCase *tc = tcase_create("json_deserialization");
     tcase_add_test(tc, test_null);
@@ -283,5 +506,11 @@ TCase *json_deserialize_test_case() {
     tcase_add_test(tc, test_map_1);
     tcase_add_test(tc, test_map_2);
     tcase_add_test(tc, test_map_3);
+    tcase_add_test(tc, test_map_4);
+    tcase_add_test(tc, test_map_5);
+    tcase_add_test(tc, test_map_6);
+    tcase_add_test(tc, test_allocator);
+    tcase_add_test(tc, test_arena);
+    tcase_add_test(tc, test_arena_heap);
     return tc;
 }
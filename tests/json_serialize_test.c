@@ -101,8 +101,17 @@ TEST_FW_BW(test_map_1, "{}", 2);
 TEST_FW_BW(test_map_2, "{\"hello\":\"world\"}", 17);
 TEST_FW_BW(test_map_3, "{\"0\":0,\"1\":1}", 13);
 TEST_FW_BW(test_map_4, "{\"code\":0}", 12);
+TEST_FW_BW(test_map_5, "{\"b\":1,\"a\":2,\"c\":3}", 19);
 
 TEST_FW_BW(test_float_1, "0.5", 3);
+START_TEST (test_float_2) {
+    object *obj = object_float(-1.2345678901234568e-300);
+    STR_INIT(float_str, "-1.2345678901234568e-300", 24);
+    char_t *out = object_to_json(obj, false);
+    fail_unless(str_strcmp(float_str, out) == 0, NULL);
+    free(out);
+    object_free(obj);
+} END_TEST
 
 TCase *json_serialize_test_case() {
     TCase *tc = tcase_create("json_serialization");
@@ -127,6 +136,8 @@ TCase *json_serialize_test_case() {
     tcase_add_test(tc, test_map_2);
     tcase_add_test(tc, test_map_3);
     tcase_add_test(tc, test_map_4);
+    tcase_add_test(tc, test_map_5);
     tcase_add_test(tc, test_float_1);
+    tcase_add_test(tc, test_float_2);
     return tc;
 }
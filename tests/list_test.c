@@ -152,9 +152,188 @@ START_TEST (test_2) {
     object_free(obj);
 } END_TEST
 
+START_TEST (test_3) {
+    object *obj = object_list();
+    object *val;
+    int32_t i;
+    
+    for (i = 0; i < 10000; ++i) {
+        val = object_int(i);
+        object_list_set(obj, i, val);
+        object_free(val);
+    }
+    fail_unless(object_list_length(obj) == 10000, NULL);
+    
+    val = object_int(-1);
+    object_list_insert_at(obj, 5000, val);
+    object_free(val);
+    
+    val = object_list_get(obj, 5000);
+    fail_unless(object_int_get(val) == -1, NULL);
+    object_free(val);
+    
+    val = object_list_get(obj, 5001);
+    fail_unless(object_int_get(val) == 5000, NULL);
+    object_free(val);
+    
+    for (i = 0; i < 5000; ++i) {
+        object_list_remove(obj, 0);
+    }
+    fail_unless(object_list_length(obj) == 5001, NULL);
+    
+    for (i = 1; i < 5001; ++i) {
+        val = object_list_get(obj, i);
+        fail_unless(object_int_get(val) == 4999 + i, NULL);
+        object_free(val);
+    }
+    
+    object_free(obj);
+} END_TEST
+
+START_TEST (test_4) {
+    object *obj = object_list();
+    object *val;
+    int32_t i;
+    
+    for (i = 0; i < 1000; ++i) {
+        val = object_int(i);
+        object_list_set(obj, i, val);
+        object_free(val);
+    }
+    
+    object *copy = object_copy(obj);
+    
+    val = object_int(-1);
+    object_list_set(copy, 500, val);
+    object_list_insert_at(copy, 0, val);
+    object_free(val);
+    object_list_remove(copy, 1000);
+    
+    fail_unless(object_list_length(obj) == 1000, NULL);
+    fail_unless(object_list_length(copy) == 1000, NULL);
+    for (i = 0; i < 1000; ++i) {
+        val = object_list_get(obj, i);
+        fail_unless(object_int_get(val) == i, NULL);
+        object_free(val);
+    }
+    
+    val = object_list_get(copy, 501);
+    fail_unless(object_int_get(val) == -1, NULL);
+    object_free(val);
+    
+    object_free(obj);
+    
+    val = object_list_get(copy, 998);
+    fail_unless(object_int_get(val) == 997, NULL);
+    object_free(val);
+    
+    object_free(copy);
+} END_TEST
+
+START_TEST (test_5) {
+    object *items[100];
+    object *val;
+    int32_t i;
+    
+    for (i = 0; i < 100; ++i) {
+        items[i] = object_int(i);
+    }
+    object *obj = object_list_from_array(items, 0);
+    fail_unless(object_list_length(obj) == 0, NULL);
+    object_free(obj);
+    obj = object_list_from_array(items, 100);
+    fail_unless(object_list_length(obj) == 100, NULL);
+    
+    object_list_push(obj, object_int(100));
+    object_list_insert_at(obj, 0, items[0]);
+    object_list_push(obj, object_int(101));
+    fail_unless(object_list_length(obj) == 103, NULL);
+    
+    for (i = 1; i < 103; ++i) {
+        val = object_list_get(obj, i);
+        fail_unless(object_int_get(val) == i - 1, NULL);
+        object_free(val);
+    }
+    
+    object_free(obj);
+} END_TEST
+
+START_TEST (test_6) {
+    object *obj = object_list();
+    object *val, *a, *b;
+    int32_t i;
+    
+    for (i = 0; i < 1000; ++i) {
+        object_list_push(obj, object_int(i));
+    }
+    
+    object_list_split_at(obj, 300, &a, &b);
+    fail_unless(object_list_length(a) == 300, NULL);
+    fail_unless(object_list_length(b) == 700, NULL);
+    
+    val = object_list_get(b, 0);
+    fail_unless(object_int_get(val) == 300, NULL);
+    object_free(val);
+    
+    object *joined = object_list_concat(b, a);
+    fail_unless(object_list_length(joined) == 1000, NULL);
+    for (i = 0; i < 1000; ++i) {
+        val = object_list_get(joined, i);
+        fail_unless(object_int_get(val) == (i + 300) % 1000, NULL);
+        object_free(val);
+    }
+    
+    object *slice = object_list_slice(joined, 650, 750);
+    fail_unless(object_list_length(slice) == 100, NULL);
+    val = object_list_get(slice, 0);
+    fail_unless(object_int_get(val) == 950, NULL);
+    object_free(val);
+    val = object_list_get(slice, 99);
+    fail_unless(object_int_get(val) == 49, NULL);
+    object_free(val);
+    
+    fail_unless(object_list_length(obj) == 1000, NULL);
+    
+    object_free(obj);
+    object_free(a);
+    object_free(b);
+    object_free(joined);
+    object_free(slice);
+} END_TEST
+
+START_TEST (test_7) {
+    object *obj = object_list();
+    object *out[100];
+    int32_t i;
+    
+    for (i = 0; i < 1000; ++i) {
+        object_list_push(obj, object_int(i));
+    }
+    object_list_insert_at(obj, 0, out[0] = object_int(-1));
+    object_free(out[0]);
+    
+    fail_unless(object_list_get_range(obj, 101, 100, out, true) == 100, NULL);
+    for (i = 0; i < 100; ++i) {
+        fail_unless(object_int_get(out[i]) == 100 + i, NULL);
+    }
+    
+    fail_unless(object_list_get_range(obj, 951, 100, out, false) == 50, NULL);
+    for (i = 0; i < 50; ++i) {
+        fail_unless(object_int_get(out[i]) == 950 + i, NULL);
+        object_free(out[i]);
+    }
+    
+    object_free(obj);
+} END_TEST
+
 TCase *list_test_case() {
     TCase *tc = tcase_create("list");
     tcase_add_test(tc, test_1);
     tcase_add_test(tc, test_2);
+    tcase_add_test(tc, test_3);
+    tcase_add_test(tc, test_4);
+    tcase_add_test(tc, test_5);
+    tcase_add_test(tc, test_6);
+    tcase_add_test(tc, test_7);
     return tc;
 }
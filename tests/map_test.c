@@ -39,8 +39,171 @@ START_TEST (test_1) {
     object_free(obj);
 } END_TEST
 
+START_TEST (test_2) {
+    object *obj = object_map_persistent();
+    object *key, *val, *out;
+    int64_t i;
+    
+    for (i = 0; i < 1000; ++i) {
+        key = object_int(i);
+        val = object_int(i * 2);
+        object_map_set(obj, key, val);
+        object_free(key);
+        object_free(val);
+    }
+    
+    object *copy = object_copy(obj);
+    
+    key = object_int(10);
+    val = object_int(-1);
+    object_map_set(copy, key, val);
+    object_free(val);
+    object_free(key);
+    
+    key = object_int(20);
+    object_map_rem(copy, key);
+    object_free(key);
+    
+    key = object_int(10);
+    out = object_map_get(obj, key);
+    fail_unless(object_int_get(out) == 20, NULL);
+    object_free(out);
+    out = object_map_get(copy, key);
+    fail_unless(object_int_get(out) == -1, NULL);
+    object_free(out);
+    object_free(key);
+    
+    key = object_int(20);
+    out = object_map_get(obj, key);
+    fail_unless(object_int_get(out) == 40, NULL);
+    object_free(out);
+    fail_unless(object_map_get(copy, key) == NULL, NULL);
+    object_free(key);
+    
+    object_free(obj);
+    object_free(copy);
+} END_TEST
+
+START_TEST (test_3) {
+    object *obj = object_map();
+    object *key, *val, *out;
+    int64_t i;
+    
+    for (i = 0; i < 10000; ++i) {
+        key = object_int(i * 128);
+        val = object_int(i);
+        object_map_set(obj, key, val);
+        object_free(key);
+        object_free(val);
+    }
+    
+    for (i = 0; i < 10000; i += 2) {
+        key = object_int(i * 128);
+        object_map_rem(obj, key);
+        object_free(key);
+    }
+    
+    for (i = 0; i < 10000; ++i) {
+        key = object_int(i * 128);
+        out = object_map_get(obj, key);
+        if (i % 2 == 0) {
+            fail_unless(out == NULL, NULL);
+        } else {
+            fail_unless(object_int_get(out) == i, NULL);
+            object_free(out);
+        }
+        object_free(key);
+    }
+    
+    key = object_int(1);
+    fail_unless(object_map_get(obj, key) == NULL, NULL);
+    object_free(key);
+    
+    object_free(obj);
+} END_TEST
+
+START_TEST (test_4) {
+    object *obj = object_map();
+    object *key, *val, *out;
+    int64_t i, n;
+    
+    /* grows past the small map limit and back down, checking every step */
+    for (n = 1; n <= 12; ++n) {
+        key = object_int(n);
+        val = object_int(n * 3);
+        object_map_set(obj, key, val);
+        object_free(key);
+        object_free(val);
+        for (i = 1; i <= n; ++i) {
+            key = object_int(i);
+            out = object_map_get(obj, key);
+            fail_unless(object_int_get(out) == i * 3, NULL);
+            object_free(out);
+            object_free(key);
+        }
+    }
+    
+    key = object_int(1);
+    object_map_rem(obj, key);
+    object_free(key);
+    key = object_int(13);
+    fail_unless(object_map_get(obj, key) == NULL, NULL);
+    object_free(key);
+    
+    object *small = object_map();
+    key = object_int(7);
+    val = object_int(70);
+    object_map_set(small, key, val);
+    object_free(val);
+    object_map_rem(small, key);
+    fail_unless(object_map_get(small, key) == NULL, NULL);
+    object_free(key);
+    
+    object_free(small);
+    object_free(obj);
+} END_TEST
+
+START_TEST (test_5) {
+    object *obj = object_map_with_capacity(100);
+    object *key, *val, *out;
+    int64_t i;
+    
+    for (i = 0; i < 100; ++i) {
+        key = object_int(i);
+        val = object_int(-i);
+        object_map_set(obj, key, val);
+        object_free(key);
+        object_free(val);
+    }
+    object_map_reserve(obj, 1000);
+    for (i = 0; i < 95; ++i) {
+        key = object_int(i);
+        object_map_rem(obj, key);
+        object_free(key);
+    }
+    object_map_shrink_to_fit(obj);
+    
+    for (i = 0; i < 100; ++i) {
+        key = object_int(i);
+        out = object_map_get(obj, key);
+        if (i < 95) {
+            fail_unless(out == NULL, NULL);
+        } else {
+            fail_unless(object_int_get(out) == -i, NULL);
+            object_free(out);
+        }
+        object_free(key);
+    }
+    
+    object_free(obj);
+} END_TEST
+
 TCase *map_test_case() {
     TCase *tc = tcase_create("map");
     tcase_add_test(tc, test_1);
+    tcase_add_test(tc, test_2);
+    tcase_add_test(tc, test_3);
+    tcase_add_test(tc, test_4);
+    tcase_add_test(tc, test_5);
     return tc;
 }
@@ -17,10 +17,14 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "math.h"
+#include "pthread.h"
 #include "stdlib.h"
+#include "string.h"
 
 #include "primitive_test.h"
 #include "object.h"
+#include "hash.h"
 
 START_TEST (none_test) {
     object *obj = object_none();
@@ -35,6 +39,30 @@ START_TEST (int_test) {
     object_free(obj);
 } END_TEST
 
+START_TEST (int_range_test) {
+    int64_t values[] = {0, -1, 1, INT64_MAX / 2, INT64_MAX / 2 + 1,
+                        INT64_MIN / 2, INT64_MIN / 2 - 1, INT64_MAX, INT64_MIN};
+    size_t i;
+    for (i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        object *obj = object_int(values[i]);
+        object *copy = object_copy(obj);
+        fail_unless(object_type(obj) == OBJECT_INT, NULL);
+        fail_unless(object_int_get(copy) == values[i], NULL);
+        object_free(obj);
+        object_free(copy);
+    }
+} END_TEST
+
+START_TEST (small_int_test) {
+    object *a = object_int(7);
+    object *b = object_int(7);
+    fail_unless(a == b, NULL);
+    object_free(a);
+    object_free(b);
+    object_free(object_copy(a));
+    fail_unless(object_int_get(a) == 7, NULL);
+} END_TEST
+
 START_TEST (bool_test) {
     object *tr = object_bool(true);
     object *fa = object_bool(false);
@@ -53,6 +81,22 @@ START_TEST (float_test) {
     object_free(obj);
 } END_TEST
 
+START_TEST (float_range_test) {
+    double values[] = {0.0, -0.0, 0.5, -2.25, 1e300, -1e-300, 1e-320,
+                       3.0e38, INFINITY, -INFINITY};
+    size_t i;
+    for (i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        object *obj = object_float(values[i]);
+        fail_unless(object_type(obj) == OBJECT_FLOAT, NULL);
+        fail_unless(object_float_get(obj) == values[i], NULL);
+        fail_unless(signbit(object_float_get(obj)) == signbit(values[i]), NULL);
+        object_free(obj);
+    }
+    object *nan = object_float(NAN);
+    fail_unless(isnan(object_float_get(nan)), NULL);
+    object_free(nan);
+} END_TEST
+
 START_TEST (str_test) {
     STR_INIT(a, "test", 4);
     object *obj = object_str(a);
@@ -63,12 +107,136 @@ START_TEST (str_test) {
     object_free(obj);
 } END_TEST
 
+START_TEST (hash_test) {
+    STR_INIT(a, "a longer key than one word", 26);
+    STR_INIT(b, "a longer key than one word", 26);
+    object *x = object_str(a);
+    object *y = object_str(b);
+    fail_unless(object_hash(x) == object_hash(y), NULL);
+    object_free(x);
+    object_free(y);
+    
+    x = object_int(1);
+    y = object_int(1);
+    fail_unless(object_hash(x) == object_hash(y), NULL);
+    object_free(y);
+    y = object_int(2);
+    fail_unless(object_hash(x) != object_hash(y), NULL);
+    object_free(x);
+    object_free(y);
+} END_TEST
+
+/*
+ * a word equal to one of wyhash's public constants zeroes a multiply, which
+ * mustn't make the rest of the key irrelevant
+ */
+START_TEST (hash_zero_word_test) {
+    uint64_t word = 0xe7037ed1a0b428dbull;
+    uint32_t high = (uint32_t) (word >> 32), low = (uint32_t) word;
+    uint8_t key[32], short_key[16];
+    uint64_t first = 0, short_first = 0;
+    uint32_t i;
+    for (i = 0; i < 16; ++i) {
+        memset(key, 'x', sizeof(key));
+        memcpy(key, &word, sizeof(word));
+        memcpy(key + 8, &i, sizeof(i));
+        memset(short_key, 'y', sizeof(short_key));
+        memcpy(short_key, &high, sizeof(high));
+        memcpy(short_key + 4, &i, sizeof(i));
+        memcpy(short_key + 8, &low, sizeof(low));
+        uint64_t h = hash_bytes(key, sizeof(key));
+        uint64_t short_h = hash_bytes(short_key, sizeof(short_key));
+        if (i == 0) {
+            first = h;
+            short_first = short_h;
+        } else {
+            fail_unless(h != first, NULL);
+            fail_unless(short_h != short_first, NULL);
+        }
+    }
+} END_TEST
+
+START_TEST (intern_test) {
+    STR_INIT(a, "key", 3);
+    STR_INIT(b, "other", 5);
+    object *x = object_str_intern(a);
+    object *y = object_str_intern(a);
+    object *z = object_str_intern(b);
+    object *plain = object_str(a);
+    fail_unless(x == y, NULL);
+    fail_unless(x != z, NULL);
+    fail_unless(!object_eq(x, z), NULL);
+    fail_unless(object_eq(x, plain), NULL);
+    fail_unless(object_hash(x) == object_hash(plain), NULL);
+    object_free(x);
+    object_free(y);
+    object_free(z);
+    
+    /* freed atoms leave the table, so interning again makes a new one */
+    x = object_str_intern(a);
+    fail_unless(object_eq(x, plain), NULL);
+    object_free(x);
+    object_free(plain);
+} END_TEST
+
+START_TEST (intern_arena_test) {
+    STR_INIT(a, "key", 3);
+    arena *region = arena_new();
+    arena *prev = mem_use_arena(region);
+    object *x = object_str_intern(a);
+    mem_use_arena(prev);
+    
+    /* interned strings never come from the arena */
+    arena_free(region);
+    object *y = object_str_intern(a);
+    fail_unless(x == y, NULL);
+    fail_unless(object_eq(x, y), NULL);
+    object_free(y);
+    object_free(x);
+} END_TEST
+
+static void *intern_worker(void *str) {
+    int i;
+    for (i = 0; i < 10000; ++i) {
+        object *x = object_str_intern(str);
+        object *y = object_copy(x);
+        object_free(x);
+        object_free(y);
+    }
+    return NULL;
+}
+
+START_TEST (intern_thread_test) {
+    STR_INIT(a, "shared", 6);
+    pthread_t threads[4];
+    int i;
+    object *x = object_str_intern(a);
+    for (i = 0; i < 4; ++i) {
+        pthread_create(&threads[i], NULL, intern_worker, a);
+    }
+    for (i = 0; i < 4; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    object *y = object_str_intern(a);
+    fail_unless(x == y, NULL);
+    object_free(y);
+    object_free(x);
+} END_TEST
+
 TCase *primitive_test_case() {
     TCase *tc = tcase_create("primitive");
     tcase_add_test(tc, none_test);
     tcase_add_test(tc, int_test);
+    tcase_add_test(tc, int_range_test);
+    tcase_add_test(tc, small_int_test);
     tcase_add_test(tc, bool_test);
     tcase_add_test(tc, float_test);
+    tcase_add_test(tc, float_range_test);
     tcase_add_test(tc, str_test);
+    tcase_add_test(tc, hash_test);
+    tcase_add_test(tc, hash_zero_word_test);
+    tcase_add_test(tc, intern_test);
+    tcase_add_test(tc, intern_arena_test);
+    tcase_add_test(tc, intern_thread_test);
     return tc;
 }